@@ -14,22 +14,34 @@
 #include <shellapi.h>   // For Shell_NotifyIcon (system tray)
 #include <gdiplus.h>    // For PNG image loading
 #include <mmsystem.h>   // For timeBeginPeriod/timeEndPeriod
+#include <psapi.h>      // For GetProcessMemoryInfo (ingestion benchmark)
+#include <algorithm>
+#include <cstdarg>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "textdecode.h"    // Portable encoding detection and UTF-8/UTF-16 decoding
+#include "textnormalize.h" // Portable smart-character and transliteration table
+#include "pasteplan.h"     // Portable keystroke ops, plan cursor and stream chunk cuts
+
 using namespace Gdiplus;
 
 // Link common controls
 #pragma comment(lib, "comctl32.lib")
 #pragma comment(lib, "gdiplus.lib")
 #pragma comment(lib, "winmm.lib")
+#pragma comment(lib, "psapi.lib")
+
+// High-resolution waitable timers (Windows 10 1803+); older SDK headers lack the flag
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
 
 // ============================================================================
 // Constants and Control IDs
 // ============================================================================
 
-const int maxchar = 45000;
-
 // Injection modes for different target types
 enum class InjectionMode {
     Unicode,    // KEYEVENTF_UNICODE - works for local apps
@@ -42,7 +54,19 @@ enum class InjectionMode {
 enum class PacingStrategy {
     Burst,        // Send chunk, pause after - for local targets
     PerCharacter, // Pause after each complete character - for remote
-    PerEvent      // Pause between every INPUT event - most conservative
+    PerEvent,     // Pause between every INPUT event - most conservative
+    Adaptive,     // Per character, delay tuned from hook acknowledgements - for remote
+    LineBurst,    // Whole lines per SendInput, short pause per line - for local targets
+    TokenBucket   // Bursts up to a bucket depth, refilled at a sustainable rate - for RDP
+};
+
+// Target families with different costs and Unicode reliability (see the encoding cost model)
+enum class TargetClass {
+    Local,        // Ordinary local window
+    Rdp,          // mstsc / Azure Virtual Desktop
+    Citrix,       // Citrix Receiver / seamless apps
+    Vnc,          // VNC viewers
+    Browser       // Browser consoles (noVNC, Azure Bastion)
 };
 
 // Input injection constants (legacy burst mode)
@@ -50,7 +74,9 @@ const int CHUNK_SIZE = 2;             // Characters per SendInput batch (conserv
 const int INTER_CHUNK_PAUSE_MS = 25;  // Base pause between chunks
 const int NEWLINE_PAUSE_MS = 100;     // Pause before/after newlines
 const int MAX_RETRY_COUNT = 3;        // Retries on partial SendInput
-const int IDLE_WAIT_MS = 50;          // Max wait for WaitForInputIdle
+const int INPUT_BATCH_SIZE = 64;      // Max INPUT events per SendInput call (Burst)
+const int IDLE_WAIT_MS = 50;          // Max backpressure wait for a busy local target
+const double BACKPRESSURE_POLL_MS = 0.5; // Input-queue poll interval while the target is busy
 
 // Per-event pacing constants (new mode)
 const int PER_EVENT_DELAY_MS = 2;     // Delay between each INPUT event
@@ -58,20 +84,105 @@ const int PER_CHAR_DELAY_MS = 5;      // Delay after each complete character
 const int LINE_START_GUARD_CHARS = 3; // Extra delay for first N chars after newline
 const int LINE_START_GUARD_MS = 10;   // Extra delay per guard char
 
-// Remote client window classes (null-terminated array)
-const wchar_t* REMOTE_WINDOW_CLASSES[] = {
-    L"TscShellContainerClass",  // mstsc.exe (RDP)
-    L"ICAClientClass",          // Citrix Receiver
-    L"RAIL_WINDOW",             // Citrix seamless apps
-    L"Transparent Windows Client", // Azure Virtual Desktop
-    L"vncviewer",               // VNC clients
-    L"TightVNC",
-    L"RealVNC",
-    L"MozillaWindowClass",      // Firefox (noVNC)
-    L"Chrome_WidgetWin_1",      // Chrome/Edge (noVNC, Azure Bastion)
-    nullptr
+// Per-character-class delays (paced strategies) - only risky keystrokes slow down
+const int PLAIN_CHAR_DELAY_MS = 0;     // Letters, digits, space, unshifted symbols
+const int SHIFTED_SYMBOL_DELAY_MS = 8; // Symbols that need Shift
+const int UNICODE_CHAR_DELAY_MS = 10;  // Unmappable characters sent as Unicode packets
+const int REPEAT_CHAR_DELAY_MS = 6;    // Same character as the one before
+
+// Long lines in terminal line editors (opt-in, see ColumnPacing / LineSplitColumn)
+const int COLUMN_RAMP_START = 80;      // Column where column pacing starts
+const int COLUMN_RAMP_MS_PER_100 = 5;  // Extra delay per 100 columns past the start
+const int COLUMN_RAMP_MAX_MS = 40;     // Cap on the column extra
+const int LINE_SPLIT_SEEK = 16;        // Prefer splitting at a space this close to the limit
+
+// Line-burst constants (local fast path)
+const int LINE_BURST_MAX_EVENTS = 512; // Max INPUT events per SendInput call
+const int LINE_BURST_PAUSE_MS = 2;     // Pause after each line
+
+// Token-bucket defaults (RDP / AVD absorb a short burst, then need to drain)
+const int RDP_BUCKET_DEPTH = 32;         // Events that may go back to back
+const int RDP_BUCKET_RATE = 250;         // Sustainable events per second
+
+// Learned target profiles
+const int PROFILE_SPEEDUP_STREAK = 2;   // Clean pastes in a row before speeding up
+const int PROFILE_MIN_CHAR_MS = 1;
+const int PROFILE_MAX_CHAR_MS = 60;
+const int PROFILE_MIN_NEWLINE_MS = 20;
+const int PROFILE_MAX_NEWLINE_MS = 400;
+const int PROFILE_MAX_GUARD_MS = 60;
+const int PROFILE_MAX_EVENT_MS = 20;
+const int PROFILE_MIN_BUCKET_RATE = 50;
+const int PROFILE_MAX_BUCKET_RATE = 2000;
+const double PROFILE_LAG_HIGH_MS = 40.0;  // Average hook lag that counts as congestion
+const size_t PROFILE_MAX_SECTIONS = 64; // Least recently used profiles beyond this are dropped
+
+// SendInput batch auto-tuning (learned limit persisted per window class)
+const int BATCH_PACED_MAX_EVENTS = 8;  // Cap for per-character strategies (one character per call)
+const int BATCH_TUNE_GROW_AFTER = 32;  // Clean full batches before probing a larger size
+const int BATCH_CEILING_RELAX_AFTER = 128; // Clean full batches before a failed size is retried
+
+// Pacing scheduler tuning
+const double PACING_SPIN_MS = 0.5;    // Spin instead of blocking for the last stretch
+const double PACING_MAX_LAG_MS = 5.0; // Rebase the deadline when further behind than this
+const double PACING_LATE_MS = 1.0;    // Overshoot counted as a late wake-up
+
+// Adaptive pacing (AIMD on the per-character rate, fed by the injected-event hook)
+const double ADAPTIVE_MIN_DELAY_MS = 1.0;     // Fastest per-character delay
+const double ADAPTIVE_MAX_DELAY_MS = 60.0;    // Slowest per-character delay
+const double ADAPTIVE_RATE_STEP_CPS = 10.0;   // Additive increase per acknowledged window
+const double ADAPTIVE_BACKOFF = 0.5;          // Multiplicative decrease on congestion
+const double ADAPTIVE_LAG_LOW_MS = 8.0;       // Lag below this = room to speed up
+const double ADAPTIVE_LAG_HIGH_MS = 25.0;     // Lag above this = back off
+const double ADAPTIVE_ACK_TIMEOUT_MS = 250.0; // Unobserved this long = events went missing
+const size_t ADAPTIVE_MAX_OUTSTANDING = 24;   // Submitted but unobserved events before backing off
+const size_t ADAPTIVE_IDLE_OUTSTANDING = 4;   // At most the character just sent is in flight
+
+// Target classification rules, checked in order (first match wins)
+// Each field is a case-insensitive pattern; nullptr matches anything.
+// className and image must match exactly, title is a substring match.
+// Windows that match no rule are local targets.
+struct TargetRule {
+    const wchar_t* className;
+    const wchar_t* image;
+    const wchar_t* title;
+    TargetClass target;
+};
+
+const TargetRule TARGET_RULES[] = {
+    // Remote desktop clients
+    { L"TscShellContainerClass",     nullptr,          nullptr, TargetClass::Rdp },    // mstsc.exe
+    { L"Transparent Windows Client", nullptr,          nullptr, TargetClass::Rdp },    // Azure Virtual Desktop
+    { nullptr,                       L"msrdc.exe",     nullptr, TargetClass::Rdp },    // AVD / Windows App
+    { L"ICAClientClass",             nullptr,          nullptr, TargetClass::Citrix }, // Citrix Receiver
+    { L"RAIL_WINDOW",                nullptr,          nullptr, TargetClass::Citrix }, // Citrix seamless apps
+    { nullptr,                       L"wfica32.exe",   nullptr, TargetClass::Citrix },
+    { nullptr,                       L"CDViewer.exe",  nullptr, TargetClass::Citrix },
+    { L"vncviewer",                  nullptr,          nullptr, TargetClass::Vnc },    // VNC clients
+    { L"TightVNC",                   nullptr,          nullptr, TargetClass::Vnc },
+    { L"RealVNC",                    nullptr,          nullptr, TargetClass::Vnc },
+    { nullptr,                       L"vncviewer.exe", nullptr, TargetClass::Vnc },
+    { nullptr,                       L"tvnviewer.exe", nullptr, TargetClass::Vnc },
+
+    // Browser consoles: only when the page title says so, so local
+    // Chrome, Edge and Electron apps keep full speed
+    { L"Chrome_WidgetWin_1", nullptr, L"noVNC",          TargetClass::Browser },
+    { L"Chrome_WidgetWin_1", nullptr, L"Bastion",        TargetClass::Browser },
+    { L"Chrome_WidgetWin_1", nullptr, L"Proxmox",        TargetClass::Browser },
+    { L"Chrome_WidgetWin_1", nullptr, L"Guacamole",      TargetClass::Browser },
+    { L"Chrome_WidgetWin_1", nullptr, L"Remote Console", TargetClass::Browser },
+    { L"Chrome_WidgetWin_1", nullptr, L"Serial console", TargetClass::Browser },
+    { L"MozillaWindowClass", nullptr, L"noVNC",          TargetClass::Browser },
+    { L"MozillaWindowClass", nullptr, L"Bastion",        TargetClass::Browser },
+    { L"MozillaWindowClass", nullptr, L"Proxmox",        TargetClass::Browser },
+    { L"MozillaWindowClass", nullptr, L"Guacamole",      TargetClass::Browser },
+    { L"MozillaWindowClass", nullptr, L"Remote Console", TargetClass::Browser },
+    { L"MozillaWindowClass", nullptr, L"Serial console", TargetClass::Browser },
 };
 
+// Classification results cached per window for the session
+const size_t TARGET_CACHE_SIZE = 32;
+
 // Window dimensions
 const int WINDOW_WIDTH = 400;
 const int WINDOW_HEIGHT = 439;
@@ -94,6 +205,20 @@ const int WINDOW_HEIGHT = 439;
 
 // Timer IDs
 #define IDT_COUNTDOWN           201
+#define IDT_PASTE_POLL          202
+#define IDT_FOCUS_SETTLE        203
+
+// Focus acquisition before a paste starts
+#define FOCUS_SETTLE_MS         30    // Foreground must be unchanged this long
+#define FOCUS_TIMEOUT_MS        1000  // Start anyway after this long
+#define FOCUS_POLL_MS           10
+
+// Focus-loss guard during injection
+const int FOCUS_PAUSE_POLL_MS = 20;         // Foreground re-check while paused
+const double FOCUS_RESUME_SETTLE_MS = 100.0; // Target back in front this long before resuming
+
+// Paste worker progress polling (coalesced, ~30 Hz)
+#define PASTE_POLL_INTERVAL_MS  33
 
 // Icons
 #define IDI_APPICON             100  // Embedded resource icon
@@ -101,6 +226,7 @@ const int WINDOW_HEIGHT = 439;
 // Tray icon
 #define IDI_TRAY                301
 #define WM_TRAYICON            (WM_USER + 1)
+#define WM_FOREGROUND_CHANGED  (WM_USER + 2)
 
 // Tray menu items
 #define IDM_TRAY_ARM            401
@@ -109,6 +235,7 @@ const int WINDOW_HEIGHT = 439;
 
 // Hotkey IDs
 #define IDH_PASTE_HOTKEY        501
+#define IDH_PAUSE_HOTKEY        502
 
 // Floating progress window
 #define FLOATING_PROGRESS_CLASS L"MadPasterFloatingProgress"
@@ -172,6 +299,17 @@ struct AppState {
     InjectionMode injectionMode;
     bool diagnosticMode;
     bool silentMode;
+
+    // Long-line handling for terminal line editors (INI only)
+    bool columnPacing;          // Slow down as the column grows
+    int lineSplitColumn;        // Split lines longer than this (0 = off)
+    wchar_t lineContinuation;   // Shell continuation character used when splitting
+
+    // Type characters the target layout lacks as their nearest ASCII spelling (INI only)
+    bool transliterate;
+
+    // Benchmark to run instead of the UI (--bench=<name>)
+    std::wstring benchmarkName;
 };
 
 static AppState g_app = {};
@@ -180,55 +318,106 @@ static AppState g_app = {};
 // File Encoding Support
 // ============================================================================
 
-enum class FileEncoding {
-    UTF8_BOM,
-    UTF16_LE_BOM,
-    UTF16_BE_BOM,
-    ANSI_OR_UTF8
-};
+// Detection, UTF-8 validation and UTF-8/UTF-16 decoding live in textdecode.h;
+// legacy code pages (ANSI) go through MultiByteToWideChar
 
-// Detect file encoding from BOM
-FileEncoding detectEncoding(const std::vector<unsigned char>& buffer) {
-    if (buffer.size() >= 3 &&
-        buffer[0] == 0xEF && buffer[1] == 0xBB && buffer[2] == 0xBF) {
-        return FileEncoding::UTF8_BOM;
-    }
-    if (buffer.size() >= 2 && buffer[0] == 0xFF && buffer[1] == 0xFE) {
-        return FileEncoding::UTF16_LE_BOM;
-    }
-    if (buffer.size() >= 2 && buffer[0] == 0xFE && buffer[1] == 0xFF) {
-        return FileEncoding::UTF16_BE_BOM;
-    }
-    return FileEncoding::ANSI_OR_UTF8;
-}
+// Append multi-byte text converted to UTF-16
+void appendWide(UINT codePage, const unsigned char* str, size_t len, std::wstring& out) {
+    if (len == 0) return;
 
-// Convert UTF-8 to wide string
-std::wstring utf8ToWide(const char* utf8Str, size_t len) {
-    if (len == 0) return L"";
+    const char* chars = reinterpret_cast<const char*>(str);
+    int wideLen = MultiByteToWideChar(codePage, 0, chars, static_cast<int>(len), nullptr, 0);
+    if (wideLen == 0) return;
 
-    int wideLen = MultiByteToWideChar(CP_UTF8, 0, utf8Str,
-                                       static_cast<int>(len), nullptr, 0);
-    if (wideLen == 0) return L"";
+    size_t start = out.size();
+    out.resize(start + wideLen);
+    MultiByteToWideChar(codePage, 0, chars, static_cast<int>(len), &out[start], wideLen);
+}
 
-    std::wstring wideStr(wideLen, 0);
-    MultiByteToWideChar(CP_UTF8, 0, utf8Str, static_cast<int>(len),
-                        &wideStr[0], wideLen);
-    return wideStr;
+// Length of data without a trailing DBCS lead byte
+size_t completeAnsiLength(const unsigned char* data, size_t size) {
+    size_t i = 0;
+    while (i < size) {
+        if (!IsDBCSLeadByte(data[i])) {
+            i++;
+        } else if (i + 1 < size) {
+            i += 2;
+        } else {
+            return i;
+        }
+    }
+    return size;
 }
 
-// Convert ANSI to wide string
-std::wstring ansiToWide(const char* ansiStr, size_t len) {
-    if (len == 0) return L"";
+// Incremental file decoder over views of a mapped file. A view can end
+// anywhere - inside the BOM, a UTF-8 sequence, a DBCS pair or a UTF-16 unit -
+// so Decode consumes only whole characters and the next view starts at the
+// first byte it left. Text is decoded straight into the caller's buffer.
+struct TextDecoder {
+    textdecode::Encoding encoding;
+    bool started;              // Encoding has been detected
+    bool checked;              // First UTF-8 view validated (BOM-less files)
+    bool ansi;                 // No BOM and the first view is not valid UTF-8
+
+    TextDecoder() : encoding(textdecode::Encoding::Unknown), started(false),
+                    checked(false), ansi(false) {}
+
+    // Decode bytes and append them to out; returns the number of bytes consumed
+    // (all of them when last is set)
+    size_t Decode(const unsigned char* data, size_t size, bool last, std::wstring& out) {
+        size_t bom = 0;
+        if (!started) {
+            if (size < 3 && !last) return 0;  // BOM may still be incomplete
+            textdecode::Detection detected = textdecode::DetectEncoding(data, size);
+            encoding = detected.encoding;
+            bom = detected.bomBytes;
+            started = true;
+        }
+
+        const unsigned char* bytes = data + bom;
+        size_t length = size - bom;
+        size_t complete = length;
+        size_t start = out.size();
+        switch (encoding) {
+            case textdecode::Encoding::Utf16LE:
+            case textdecode::Encoding::Utf16BE:
+                {
+                    // A trailing odd byte at the end of the file is dropped
+                    size_t units = length / 2;
+                    out.resize(start + units);
+                    textdecode::DecodeUtf16(bytes, units * 2,
+                                            encoding == textdecode::Encoding::Utf16BE, &out[start]);
+                    if (!last) complete = units * 2;
+                }
+                break;
 
-    int wideLen = MultiByteToWideChar(CP_ACP, 0, ansiStr,
-                                       static_cast<int>(len), nullptr, 0);
-    if (wideLen == 0) return L"";
+            case textdecode::Encoding::Utf8:
+            case textdecode::Encoding::Unknown:
+            default:
+                if (!ansi) {
+                    if (!last) complete = textdecode::CompleteUtf8Length(bytes, length);
+                    out.resize(start + complete);
+                    bool valid = true;
+                    size_t units = textdecode::DecodeUtf8(bytes, complete, &out[start], valid);
+                    out.resize(start + units);
+
+                    // Without a BOM the first view decides between UTF-8 and ANSI;
+                    // invalid UTF-8 later on keeps its replacement characters
+                    bool firstCheck = (encoding == textdecode::Encoding::Unknown && !checked);
+                    checked = true;
+                    if (valid || !firstCheck) break;
+                    ansi = true;
+                    out.resize(start);
+                    complete = length;
+                }
+                if (!last) complete = completeAnsiLength(bytes, length);
+                appendWide(CP_ACP, bytes, complete, out);
+                break;
+        }
 
-    std::wstring wideStr(wideLen, 0);
-    MultiByteToWideChar(CP_ACP, 0, ansiStr, static_cast<int>(len),
-                        &wideStr[0], wideLen);
-    return wideStr;
-}
+        return bom + complete;
+    }
+};
 
 // ============================================================================
 // Clipboard Functions
@@ -285,6 +474,8 @@ std::wstring getClipboardText() {
         return L"";
     }
 
+    // The one full copy of a clipboard paste: the clipboard owns this memory and
+    // may change while the text is typed. Later stages work on views of the copy.
     std::wstring text(pszText);
     GlobalUnlock(hData);
     return text;
@@ -294,8 +485,14 @@ std::wstring getClipboardText() {
 // File Reading Functions
 // ============================================================================
 
-std::wstring readFileContents(const std::wstring& filePath, bool& success) {
-    success = false;
+// Files are mapped and decoded one view of this size at a time
+const size_t FILE_VIEW_BYTES = 1024 * 1024;
+
+// Check that a file can be pasted before the paste starts; reports problems
+// to the user. There is no size limit - the paste worker streams the text.
+// estimatedUnits is the decoded length to expect (for progress).
+bool checkSourceFile(const std::wstring& filePath, size_t& estimatedUnits) {
+    estimatedUnits = 0;
 
     HANDLE hFile = CreateFileW(
         filePath.c_str(),
@@ -313,7 +510,7 @@ std::wstring readFileContents(const std::wstring& filePath, bool& success) {
                                  std::to_wstring(error) + L"\n\nFile: " + filePath;
         MessageBox(nullptr, errorMsg.c_str(), L"MadPaster - File Error",
                    MB_OK | MB_ICONERROR | MB_TOPMOST);
-        return L"";
+        return false;
     }
 
     LARGE_INTEGER fileSize;
@@ -321,76 +518,98 @@ std::wstring readFileContents(const std::wstring& filePath, bool& success) {
         CloseHandle(hFile);
         MessageBox(nullptr, L"Failed to get file size.", L"MadPaster - File Error",
                    MB_OK | MB_ICONERROR | MB_TOPMOST);
-        return L"";
+        return false;
     }
 
-    const LONGLONG maxFileSize = 500 * 1024; // 500 KB
-    if (fileSize.QuadPart > maxFileSize) {
+    if (fileSize.QuadPart == 0) {
         CloseHandle(hFile);
-        MessageBox(nullptr, L"File too large.\nMaximum file size: 500KB",
+        MessageBox(nullptr, L"File is empty.",
                    L"MadPaster - File Error", MB_OK | MB_ICONERROR | MB_TOPMOST);
-        return L"";
+        return false;
+    }
+
+    // UTF-16 files hold two bytes per unit; UTF-8 and ANSI at most one unit per byte
+    unsigned char sample[textdecode::DETECT_SAMPLE_BYTES];
+    DWORD bytesRead = 0;
+    ReadFile(hFile, sample, sizeof(sample), &bytesRead, nullptr);
+    CloseHandle(hFile);
+
+    textdecode::Detection detected = textdecode::DetectEncoding(sample, bytesRead);
+    size_t bytes = static_cast<size_t>(fileSize.QuadPart) - detected.bomBytes;
+    bool utf16 = (detected.encoding == textdecode::Encoding::Utf16LE ||
+                  detected.encoding == textdecode::Encoding::Utf16BE);
+    estimatedUnits = utf16 ? bytes / 2 : bytes;
+    return true;
+}
+
+// Read a file through a read-only mapping, one view at a time, handing each
+// decoded view to onBlock, which returns false to stop early. Only one view
+// and its decoded text are resident at a time, whatever the file size.
+// Returns false with error set if the file can't be opened or mapped.
+template <typename BlockFn>
+bool readFileBlocks(const std::wstring& filePath, BlockFn onBlock, std::wstring& error) {
+    HANDLE hFile = CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                               OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        error = L"Failed to open file (error " + std::to_wstring(GetLastError()) + L")";
+        return false;
     }
 
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(hFile, &fileSize)) {
+        error = L"Failed to get file size (error " + std::to_wstring(GetLastError()) + L")";
+        CloseHandle(hFile);
+        return false;
+    }
     if (fileSize.QuadPart == 0) {
         CloseHandle(hFile);
-        MessageBox(nullptr, L"File is empty.",
-                   L"MadPaster - File Error", MB_OK | MB_ICONERROR | MB_TOPMOST);
-        return L"";
+        return true;  // Empty files can't be mapped
     }
 
-    std::vector<unsigned char> buffer(static_cast<size_t>(fileSize.QuadPart));
-    DWORD bytesRead;
-    if (!ReadFile(hFile, buffer.data(), static_cast<DWORD>(fileSize.QuadPart),
-                  &bytesRead, nullptr)) {
+    HANDLE hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!hMapping) {
+        error = L"Failed to map file (error " + std::to_wstring(GetLastError()) + L")";
         CloseHandle(hFile);
-        MessageBox(nullptr, L"Failed to read file.", L"MadPaster - File Error",
-                   MB_OK | MB_ICONERROR | MB_TOPMOST);
-        return L"";
+        return false;
     }
-    CloseHandle(hFile);
-
-    FileEncoding encoding = detectEncoding(buffer);
-    std::wstring result;
-
-    switch (encoding) {
-        case FileEncoding::UTF8_BOM:
-            result = utf8ToWide(reinterpret_cast<char*>(buffer.data() + 3),
-                               bytesRead - 3);
-            break;
 
-        case FileEncoding::UTF16_LE_BOM:
-            result = std::wstring(
-                reinterpret_cast<wchar_t*>(buffer.data() + 2),
-                (bytesRead - 2) / sizeof(wchar_t)
-            );
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    ULONGLONG granularity = systemInfo.dwAllocationGranularity;
+    ULONGLONG size = static_cast<ULONGLONG>(fileSize.QuadPart);
+
+    TextDecoder decoder;
+    std::wstring decoded;
+    bool success = true;
+    ULONGLONG offset = 0;  // First byte not decoded yet
+
+    while (offset < size) {
+        // Views must start on the allocation granularity; decoding resumes inside the view
+        ULONGLONG viewStart = offset - offset % granularity;
+        size_t viewBytes = static_cast<size_t>((std::min)(static_cast<ULONGLONG>(FILE_VIEW_BYTES),
+                                                          size - viewStart));
+        const unsigned char* view = static_cast<const unsigned char*>(
+            MapViewOfFile(hMapping, FILE_MAP_READ, static_cast<DWORD>(viewStart >> 32),
+                          static_cast<DWORD>(viewStart), viewBytes));
+        if (!view) {
+            error = L"Failed to map file view (error " + std::to_wstring(GetLastError()) + L")";
+            success = false;
             break;
+        }
 
-        case FileEncoding::UTF16_BE_BOM:
-            {
-                size_t charCount = (bytesRead - 2) / sizeof(wchar_t);
-                result.resize(charCount);
-                for (size_t i = 0; i < charCount; ++i) {
-                    unsigned char hi = buffer[2 + i * 2];
-                    unsigned char lo = buffer[2 + i * 2 + 1];
-                    result[i] = static_cast<wchar_t>((hi << 8) | lo);
-                }
-            }
-            break;
+        size_t skip = static_cast<size_t>(offset - viewStart);
+        bool last = (viewStart + viewBytes == size);
+        decoded.clear();
+        offset += decoder.Decode(view + skip, viewBytes - skip, last, decoded);
+        UnmapViewOfFile(view);  // Also drops the view's pages from the working set
 
-        case FileEncoding::ANSI_OR_UTF8:
-        default:
-            result = utf8ToWide(reinterpret_cast<char*>(buffer.data()),
-                               bytesRead);
-            if (result.empty() && bytesRead > 0) {
-                result = ansiToWide(reinterpret_cast<char*>(buffer.data()),
-                                   bytesRead);
-            }
-            break;
+        if (!decoded.empty() && !onBlock(std::wstring_view(decoded))) break;
+        if (last) break;
     }
 
-    success = true;
-    return result;
+    CloseHandle(hMapping);
+    CloseHandle(hFile);
+    return success;
 }
 
 // Show file open dialog and return selected path
@@ -424,32 +643,296 @@ std::wstring showFileOpenDialog(HWND hwndOwner) {
 
 namespace inject {
 
-// RAII guard for high-resolution timer (1ms instead of ~15.6ms default)
-struct TimerResolutionGuard {
-    TimerResolutionGuard() { timeBeginPeriod(1); }
-    ~TimerResolutionGuard() { timeEndPeriod(1); }
+// Monotonic high-resolution timestamps (QueryPerformanceCounter ticks)
+LONGLONG QpcNow() {
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return now.QuadPart;
+}
+
+double QpcToMs(LONGLONG ticks) {
+    static LONGLONG frequency = 0;
+    if (frequency == 0) {
+        LARGE_INTEGER freq;
+        QueryPerformanceFrequency(&freq);
+        frequency = freq.QuadPart;
+    }
+    return static_cast<double>(ticks) * 1000.0 / static_cast<double>(frequency);
+}
+
+LONGLONG MsToQpc(double ms) {
+    static LONGLONG frequency = 0;
+    if (frequency == 0) {
+        LARGE_INTEGER freq;
+        QueryPerformanceFrequency(&freq);
+        frequency = freq.QuadPart;
+    }
+    return static_cast<LONGLONG>(ms * static_cast<double>(frequency) / 1000.0);
+}
+
+// Deadline-based pacing scheduler
+// Pauses advance an absolute deadline on the QPC clock rather than sleeping for a
+// relative interval, so wake-up overshoot on one pause is taken out of the next
+// and the average rate matches the configured delays. Waits use a high-resolution
+// waitable timer and spin for the final fraction of a millisecond.
+struct PacingScheduler {
+    HANDLE timer;
+    bool highResolution;     // CREATE_WAITABLE_TIMER_HIGH_RESOLUTION available
+    LONGLONG deadline;       // Absolute QPC time the current pause ends
+    LONGLONG spinTicks;      // Final stretch spent spinning instead of blocking
+    LONGLONG maxLagTicks;    // Behind by more than this = rebase instead of bursting
+    HANDLE interrupt;        // Optional event that ends waits early (abort)
+
+    // Achieved timing accuracy
+    size_t waits;
+    size_t lateWaits;        // Overshoot above PACING_LATE_MS
+    double scheduledMs;
+    double totalOvershootMs;
+    double maxOvershootMs;
+
+    PacingScheduler() : timer(nullptr), highResolution(false), deadline(0), interrupt(nullptr),
+                        waits(0), lateWaits(0), scheduledMs(0.0),
+                        totalOvershootMs(0.0), maxOvershootMs(0.0) {
+        timer = CreateWaitableTimerExW(nullptr, nullptr,
+                                       CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        highResolution = (timer != nullptr);
+        if (!highResolution) {
+            // Pre-1803 Windows: regular timer at 1 ms system resolution, spin a bit longer
+            timeBeginPeriod(1);
+            timer = CreateWaitableTimerW(nullptr, TRUE, nullptr);
+        }
+        spinTicks = MsToQpc(highResolution ? PACING_SPIN_MS : PACING_SPIN_MS * 3);
+        maxLagTicks = MsToQpc(PACING_MAX_LAG_MS);
+        deadline = QpcNow();
+    }
+
+    ~PacingScheduler() {
+        if (timer) CloseHandle(timer);
+        if (!highResolution) timeEndPeriod(1);
+    }
+
+    PacingScheduler(const PacingScheduler&) = delete;
+    PacingScheduler& operator=(const PacingScheduler&) = delete;
+
+    bool Interrupted() const {
+        return interrupt && WaitForSingleObject(interrupt, 0) == WAIT_OBJECT_0;
+    }
+
+    // Pause for ms measured from the previous deadline
+    void Pause(double ms) {
+        if (ms <= 0.0) return;
+
+        LONGLONG now = QpcNow();
+        if (now - deadline > maxLagTicks) {
+            // Stalled (slow SendInput, planning) - don't burst to catch up
+            deadline = now;
+        }
+        deadline += MsToQpc(ms);
+        scheduledMs += ms;
+        WaitUntil(deadline);
+    }
+
+    void WaitUntil(LONGLONG target) {
+        LONGLONG remaining = target - QpcNow();
+
+        if (remaining > spinTicks && timer) {
+            // Relative due time in 100 ns units (negative = relative)
+            LARGE_INTEGER due;
+            due.QuadPart = -static_cast<LONGLONG>(QpcToMs(remaining - spinTicks) * 10000.0);
+            if (SetWaitableTimer(timer, &due, 0, nullptr, nullptr, FALSE)) {
+                if (interrupt) {
+                    HANDLE handles[2] = { timer, interrupt };
+                    if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0 + 1) {
+                        CancelWaitableTimer(timer);
+                        return;  // Interrupted - the caller checks why
+                    }
+                } else {
+                    WaitForSingleObject(timer, INFINITE);
+                }
+            }
+        }
+
+        LONGLONG now = QpcNow();
+        while (now < target) {
+            YieldProcessor();
+            now = QpcNow();
+        }
+
+        double overshootMs = QpcToMs(now - target);
+        waits++;
+        totalOvershootMs += overshootMs;
+        if (overshootMs > maxOvershootMs) maxOvershootMs = overshootMs;
+        if (overshootMs > PACING_LATE_MS) lateWaits++;
+    }
 };
 
 // Information about detected remote client
 struct RemoteClientInfo {
     bool isRemote;
+    TargetClass targetClass;
     wchar_t className[256];
+    wchar_t processImage[MAX_PATH];  // Executable file name (no path)
     HWND hwnd;
     DWORD threadId;
     DWORD processId;
     HKL keyboardLayout;
 };
 
-// Check if window class is a known remote client
-bool IsKnownRemoteClass(const wchar_t* className) {
-    if (!className || !className[0]) return false;
+// Rules compiled once into lower-case patterns. A lookup scans them in table
+// order (first match wins); class names are pre-hashed so rules for other
+// classes are skipped with an integer compare, and only the few rules that
+// pass it compare image or title strings
+struct CompiledTargetRule {
+    ULONGLONG classHash;   // 0 = any class
+    std::wstring image;    // Empty = any image
+    std::wstring title;    // Empty = any title
+    TargetClass target;
+};
+
+struct TargetRuleSet {
+    std::vector<CompiledTargetRule> rules;
+    std::vector<ULONGLONG> titleClasses;  // Classes with title rules (result depends on the title)
+};
 
-    for (int i = 0; REMOTE_WINDOW_CLASSES[i] != nullptr; i++) {
-        if (_wcsicmp(className, REMOTE_WINDOW_CLASSES[i]) == 0) {
-            return true;
+std::wstring ToLowerCase(const wchar_t* text) {
+    std::wstring lower = text ? text : L"";
+    if (!lower.empty()) CharLowerBuffW(&lower[0], static_cast<DWORD>(lower.size()));
+    return lower;
+}
+
+// FNV-1a over the lower-cased class name
+ULONGLONG HashClassName(const std::wstring& lowerClass) {
+    ULONGLONG hash = 14695981039346656037ULL;
+    for (wchar_t c : lowerClass) {
+        hash ^= static_cast<ULONGLONG>(c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+TargetRuleSet CompileTargetRules() {
+    TargetRuleSet ruleSet;
+    for (const TargetRule& rule : TARGET_RULES) {
+        CompiledTargetRule compiledRule = {};
+        compiledRule.classHash = rule.className ? HashClassName(ToLowerCase(rule.className)) : 0;
+        compiledRule.image = ToLowerCase(rule.image);
+        compiledRule.title = ToLowerCase(rule.title);
+        compiledRule.target = rule.target;
+        ruleSet.rules.push_back(compiledRule);
+
+        if (rule.title && compiledRule.classHash != 0 &&
+            std::find(ruleSet.titleClasses.begin(), ruleSet.titleClasses.end(),
+                      compiledRule.classHash) == ruleSet.titleClasses.end()) {
+            ruleSet.titleClasses.push_back(compiledRule.classHash);
         }
     }
-    return false;
+    return ruleSet;
+}
+
+const TargetRuleSet& GetTargetRules() {
+    static const TargetRuleSet ruleSet = CompileTargetRules();
+    return ruleSet;
+}
+
+// Map a window to its target family
+// lowerImage and lowerTitle are lower-cased; lowerTitle may be empty
+TargetClass ClassifyTarget(ULONGLONG classHash, const std::wstring& lowerImage,
+                           const std::wstring& lowerTitle) {
+    for (const CompiledTargetRule& rule : GetTargetRules().rules) {
+        if (rule.classHash != 0 && rule.classHash != classHash) continue;
+        if (!rule.image.empty() && rule.image != lowerImage) continue;
+        if (!rule.title.empty() && lowerTitle.find(rule.title) == std::wstring::npos) continue;
+        return rule.target;
+    }
+    return TargetClass::Local;
+}
+
+bool IsTitleSensitiveClass(ULONGLONG classHash) {
+    const std::vector<ULONGLONG>& classes = GetTargetRules().titleClasses;
+    return std::find(classes.begin(), classes.end(), classHash) != classes.end();
+}
+
+// Per-window classification cache. The process image lookup and the rule scan
+// run once per window; title-sensitive windows (browsers) re-check the title,
+// since switching tabs changes the target without changing the window.
+struct TargetCacheEntry {
+    HWND hwnd;
+    DWORD processId;          // Guards against a recycled HWND
+    ULONGLONG classHash;
+    bool titleSensitive;
+    std::wstring lowerImage;
+    wchar_t processImage[MAX_PATH];
+    TargetClass target;
+    std::wstring lowerTitle;  // Title the target was classified with
+};
+
+// Both the UI thread and the paste worker detect targets
+static SRWLOCK g_targetCacheLock = SRWLOCK_INIT;
+static std::vector<TargetCacheEntry> g_targetCache;
+
+void ReadProcessImage(DWORD processId, wchar_t* image) {
+    image[0] = L'\0';
+    HANDLE hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, processId);
+    if (!hProcess) return;
+
+    wchar_t imagePath[MAX_PATH] = {};
+    DWORD size = MAX_PATH;
+    if (QueryFullProcessImageNameW(hProcess, 0, imagePath, &size)) {
+        const wchar_t* name = wcsrchr(imagePath, L'\\');
+        wcscpy_s(image, MAX_PATH, name ? name + 1 : imagePath);
+    }
+    CloseHandle(hProcess);
+}
+
+std::wstring ReadLowerTitle(HWND hwnd) {
+    wchar_t title[256] = {};
+    GetWindowTextW(hwnd, title, 256);
+    return ToLowerCase(title);
+}
+
+// Classify a window, using the session cache when possible
+void ClassifyWindow(RemoteClientInfo& info) {
+    ULONGLONG classHash = HashClassName(ToLowerCase(info.className));
+
+    AcquireSRWLockExclusive(&g_targetCacheLock);
+
+    TargetCacheEntry* entry = nullptr;
+    for (TargetCacheEntry& cached : g_targetCache) {
+        if (cached.hwnd == info.hwnd && cached.processId == info.processId &&
+            cached.classHash == classHash) {
+            entry = &cached;
+            break;
+        }
+    }
+
+    if (!entry) {
+        if (g_targetCache.size() >= TARGET_CACHE_SIZE) g_targetCache.erase(g_targetCache.begin());
+
+        TargetCacheEntry added = {};
+        added.hwnd = info.hwnd;
+        added.processId = info.processId;
+        added.classHash = classHash;
+        added.titleSensitive = IsTitleSensitiveClass(classHash);
+        ReadProcessImage(info.processId, added.processImage);
+        added.lowerImage = ToLowerCase(added.processImage);
+        if (added.titleSensitive) added.lowerTitle = ReadLowerTitle(info.hwnd);
+        added.target = ClassifyTarget(classHash, added.lowerImage, added.lowerTitle);
+        g_targetCache.push_back(added);
+        entry = &g_targetCache.back();
+    } else if (entry->titleSensitive) {
+        std::wstring lowerTitle = ReadLowerTitle(info.hwnd);
+        if (lowerTitle != entry->lowerTitle) {
+            entry->lowerTitle = lowerTitle;
+            entry->target = ClassifyTarget(classHash, entry->lowerImage, entry->lowerTitle);
+        }
+    }
+
+    wcscpy_s(info.processImage, entry->processImage);
+    info.targetClass = entry->target;
+
+    ReleaseSRWLockExclusive(&g_targetCacheLock);
+
+    info.isRemote = (info.targetClass != TargetClass::Local);
 }
 
 // Detect if foreground window is a remote client
@@ -470,8 +953,8 @@ RemoteClientInfo DetectRemoteClient() {
     // Get keyboard layout for VK mapping
     info.keyboardLayout = GetKeyboardLayout(info.threadId);
 
-    // Check if this is a known remote class
-    info.isRemote = IsKnownRemoteClass(info.className);
+    // Match class, executable and title against the target rules
+    ClassifyWindow(info);
 
     return info;
 }
@@ -507,8 +990,196 @@ void ResetModifiers() {
     SendInput(6, inputs, sizeof(INPUT));
 }
 
-// Forward declaration
-void AppendCharacterInputs(std::vector<INPUT>& buffer, wchar_t c);
+// Per-character-class pacing rules
+// PerCharacter pauses for the class delay; Adaptive and PerEvent add the
+// class's extra over plainMs to their own per-character delay
+struct PacingRules {
+    int plainMs;
+    int shiftedSymbolMs;
+    int unicodeMs;
+    int repeatMs;
+};
+
+// Pacing configuration for injection
+struct PacingConfig {
+    PacingStrategy strategy;
+    int perEventDelayMs;
+    int perCharDelayMs;        // Adaptive starting delay
+    PacingRules rules;
+    int lineStartGuardChars;
+    int lineStartGuardMs;
+    int newlinePauseMs;        // Split before and after each Enter
+    int baseKeystrokeDelayMs;  // From UI setting
+    int bucketDepth;           // TokenBucket: max events sent back to back
+    int bucketRatePerSec;      // TokenBucket: refill rate (events per second)
+    int columnRampStart;       // Column pacing starts past this column (0 = off)
+    int columnRampMsPer100;    // Extra delay per 100 columns past the start
+    int lineSplitColumn;       // Split longer lines with the continuation character (0 = off)
+    wchar_t lineContinuation;
+    bool transliterate;        // Spell characters the layout can't type (see textnormalize.h)
+    int batchSize;             // Learned SendInput batch limit for the target (0 = not known)
+};
+
+// Get default pacing config based on target type
+PacingConfig GetDefaultPacingConfig(TargetClass target) {
+    PacingConfig config = {};
+    config.perEventDelayMs = PER_EVENT_DELAY_MS;
+    config.perCharDelayMs = PER_CHAR_DELAY_MS;
+    config.rules.plainMs = PLAIN_CHAR_DELAY_MS;
+    config.rules.shiftedSymbolMs = SHIFTED_SYMBOL_DELAY_MS;
+    config.rules.unicodeMs = UNICODE_CHAR_DELAY_MS;
+    config.rules.repeatMs = REPEAT_CHAR_DELAY_MS;
+    config.lineStartGuardChars = LINE_START_GUARD_CHARS;
+    config.lineStartGuardMs = LINE_START_GUARD_MS;
+    config.newlinePauseMs = NEWLINE_PAUSE_MS;
+    config.baseKeystrokeDelayMs = g_app.keystrokeDelayMs;
+    config.bucketDepth = RDP_BUCKET_DEPTH;
+    config.bucketRatePerSec = RDP_BUCKET_RATE;
+    config.columnRampStart = g_app.columnPacing ? COLUMN_RAMP_START : 0;
+    config.columnRampMsPer100 = COLUMN_RAMP_MS_PER_100;
+    config.lineSplitColumn = g_app.lineSplitColumn;
+    config.lineContinuation = g_app.lineContinuation;
+    config.transliterate = g_app.transliterate;
+    config.batchSize = 0;
+
+    switch (target) {
+        case TargetClass::Local:
+            config.strategy = PacingStrategy::LineBurst;
+            break;
+        case TargetClass::Rdp:
+            config.strategy = PacingStrategy::TokenBucket;
+            break;
+        default:
+            // Starts at PER_CHAR_DELAY_MS and tunes itself from hook feedback
+            config.strategy = PacingStrategy::Adaptive;
+            break;
+    }
+
+    return config;
+}
+
+// Learned pacing for one target (window class + process image), kept in the INI
+// Seeded from the target class defaults and adjusted after every paste
+struct TargetProfile {
+    std::wstring key;          // "<class>|<image>"
+    bool loaded;               // Read from the INI (otherwise defaults)
+    PacingStrategy strategy;   // Always the class default; stored only to spot a change
+    int perEventDelayMs;
+    int perCharDelayMs;
+    int newlinePauseMs;
+    int lineStartGuardMs;
+    int bucketRatePerSec;
+    int batchSize;             // 0 = not learned yet
+    int pastes;                // Pastes folded into the profile
+    int cleanStreak;           // Clean pastes since the last adjustment
+
+    // Per-target overrides of the long-line and transliteration settings (-1 / 0 = use [Settings])
+    int columnPacing;
+    int lineSplitColumn;
+    wchar_t lineContinuation;
+    int transliterate;
+};
+
+std::wstring MakeProfileKey(const RemoteClientInfo& info) {
+    std::wstring image = info.processImage;
+    if (!image.empty()) CharLowerBuffW(&image[0], static_cast<DWORD>(image.size()));
+    std::wstring key = std::wstring(info.className) + L"|" + image;
+
+    // Browser consoles share class and image with the local browser; keep them apart
+    if (info.targetClass == TargetClass::Browser) key += L"|console";
+    return key;
+}
+
+TargetProfile MakeDefaultProfile(const std::wstring& key, const PacingConfig& config) {
+    TargetProfile profile = {};
+    profile.key = key;
+    profile.loaded = false;
+    profile.strategy = config.strategy;
+    profile.perEventDelayMs = config.perEventDelayMs;
+    profile.perCharDelayMs = config.perCharDelayMs;
+    profile.newlinePauseMs = config.newlinePauseMs;
+    profile.lineStartGuardMs = config.lineStartGuardMs;
+    profile.bucketRatePerSec = config.bucketRatePerSec;
+    profile.batchSize = config.batchSize;
+    profile.columnPacing = -1;
+    profile.lineSplitColumn = -1;
+    profile.lineContinuation = 0;
+    profile.transliterate = -1;
+    return profile;
+}
+
+void ApplyTargetProfile(PacingConfig& config, const TargetProfile& profile) {
+    config.strategy = profile.strategy;
+    config.perEventDelayMs = profile.perEventDelayMs;
+    config.perCharDelayMs = profile.perCharDelayMs;
+    config.newlinePauseMs = profile.newlinePauseMs;
+    config.lineStartGuardMs = profile.lineStartGuardMs;
+    config.bucketRatePerSec = profile.bucketRatePerSec;
+    config.batchSize = profile.batchSize;
+
+    if (profile.columnPacing >= 0) {
+        config.columnRampStart = profile.columnPacing ? COLUMN_RAMP_START : 0;
+    }
+    if (profile.lineSplitColumn >= 0) config.lineSplitColumn = profile.lineSplitColumn;
+    if (profile.lineContinuation) config.lineContinuation = profile.lineContinuation;
+    if (profile.transliterate >= 0) config.transliterate = (profile.transliterate != 0);
+}
+
+// ----------------------------------------------------------------------------
+// Keystroke plan
+//
+// Text is compiled into a flat stream of 4-byte KeyOps before injection starts.
+// All mapping, CRLF handling and chunking decisions happen here; the executor
+// only expands ops into fixed-size INPUT batches and applies pacing.
+// ----------------------------------------------------------------------------
+
+// KeyOp, its flags and pace classes are in pasteplan.h
+
+struct KeystrokePlan {
+    std::vector<KeyOp> ops;
+    size_t sourceUnits;        // Length of the text the plan was compiled from
+
+    // Inputs the plan was compiled from (cache key)
+    ULONGLONG textHash;
+    HKL layout;
+    InjectionMode mode;
+    TargetClass target;
+    PacingStrategy strategy;
+    int lineStartGuardChars;
+    int lineSplitColumn;
+    wchar_t lineContinuation;
+    bool transliterate;
+    size_t startColumn;        // Column the text starts at (chunk cut mid-line)
+    bool valid;
+
+    size_t endColumn;          // Column after the last character (next chunk's start)
+    size_t transliteratedChars;  // Characters spelled out because the layout lacks them
+
+    // Encoding cost (Hybrid): chosen encoding vs scancodes for everything mappable
+    size_t unicodeChars;       // Characters sent as Unicode packets
+    double costMs;
+    double vkOnlyCostMs;
+};
+
+const ULONGLONG TEXT_HASH_SEED = 14695981039346656037ULL;
+
+// FNV-1a hash over UTF-16 code units
+// Text streamed in pieces is hashed by passing the previous result as hash
+ULONGLONG HashText(const wchar_t* text, size_t length, ULONGLONG hash = TEXT_HASH_SEED) {
+    for (size_t i = 0; i < length; i++) {
+        hash ^= static_cast<ULONGLONG>(text[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+void AppendKeyOp(KeystrokePlan& plan, WORD code, BYTE flags) {
+    KeyOp op = {};
+    op.code = code;
+    op.flags = flags;
+    op.pace = PaceClass::None;
+    plan.ops.push_back(op);
+}
 
 // VK/Scancode mapping result
 struct VKMapping {
@@ -521,7 +1192,8 @@ struct VKMapping {
 // Map a character to VK code using VkKeyScanExW
 // Only accepts "safe" mappings that require no modifiers or just Shift
 // Rejects mappings that need Ctrl/Alt (would trigger shortcuts)
-VKMapping MapCharacterToVK(wchar_t ch, HKL layout) {
+// Uncached - used to fill layout tables and as the benchmark baseline
+VKMapping MapCharacterToVKUncached(wchar_t ch, HKL layout) {
     VKMapping result = {};
 
     SHORT vkResult = VkKeyScanExW(ch, layout);
@@ -543,271 +1215,626 @@ VKMapping MapCharacterToVK(wchar_t ch, HKL layout) {
     result.vk = vk;
     result.needsShift = (modifiers == 1);
 
-    // Get hardware scancode for VK
-    result.scancode = static_cast<WORD>(MapVirtualKeyW(vk, MAPVK_VK_TO_VSC));
+    // Get hardware scancode for VK in the target's layout
+    result.scancode = static_cast<WORD>(MapVirtualKeyExW(vk, MAPVK_VK_TO_VSC, layout));
 
     return result;
 }
 
-// Append character using VK code with scancode
-// Returns number of INPUT events added (2 for simple char, 4 with Shift)
-int AppendVKCharacterInputs(std::vector<INPUT>& buffer, wchar_t ch, HKL layout) {
-    VKMapping mapping = MapCharacterToVK(ch, layout);
-    if (!mapping.success) {
-        return 0;  // Caller should fall back to Unicode
+// Layout key table entry states
+const BYTE KEYMAP_UNKNOWN    = 0;  // Not resolved yet
+const BYTE KEYMAP_MAPPABLE   = 1;  // Typeable with no modifier or Shift only
+const BYTE KEYMAP_UNMAPPABLE = 2;  // Needs Unicode fallback
+
+struct KeyMapEntry {
+    BYTE vk;
+    BYTE scancode;
+    BYTE modifiers;  // VkKeyScanEx modifier bits (1 = Shift)
+    BYTE state;      // KEYMAP_*
+};
+
+// Per-layout character table covering the whole BMP (256 KB), filled lazily
+// so each character costs VkKeyScanExW at most once per layout
+struct LayoutKeyTable {
+    HKL layout;
+    WORD shiftScancode;
+    std::vector<KeyMapEntry> entries;
+};
+
+// Layout tables by HKL. Only the thread that plans touches them (the paste
+// worker, or the benchmark when no paste is running).
+const size_t MAX_LAYOUT_TABLES = 8;
+static std::vector<LayoutKeyTable*> g_layoutTables;
+
+LayoutKeyTable& GetLayoutKeyTable(HKL layout) {
+    for (LayoutKeyTable* table : g_layoutTables) {
+        if (table->layout == layout) return *table;
+    }
+
+    // Evict the oldest table once the cache is full
+    if (g_layoutTables.size() >= MAX_LAYOUT_TABLES) {
+        delete g_layoutTables.front();
+        g_layoutTables.erase(g_layoutTables.begin());
+    }
+
+    LayoutKeyTable* table = new LayoutKeyTable();
+    table->layout = layout;
+    table->shiftScancode = static_cast<WORD>(MapVirtualKeyExW(VK_SHIFT, MAPVK_VK_TO_VSC, layout));
+    table->entries.assign(0x10000, KeyMapEntry{});
+    g_layoutTables.push_back(table);
+    return *table;
+}
+
+// Drop all cached layout tables (benchmark cold-start measurements)
+void ClearLayoutKeyTables() {
+    for (LayoutKeyTable* table : g_layoutTables) delete table;
+    g_layoutTables.clear();
+}
+
+// Single array lookup once the entry is resolved
+inline const KeyMapEntry& LookupKey(LayoutKeyTable& table, wchar_t ch) {
+    KeyMapEntry& entry = table.entries[static_cast<WORD>(ch)];
+    if (entry.state == KEYMAP_UNKNOWN) {
+        VKMapping mapping = MapCharacterToVKUncached(ch, table.layout);
+        if (mapping.success && mapping.scancode <= 0xFF) {
+            entry.vk = mapping.vk;
+            entry.scancode = static_cast<BYTE>(mapping.scancode);
+            entry.modifiers = mapping.needsShift ? 1 : 0;
+            entry.state = KEYMAP_MAPPABLE;
+        } else {
+            entry.state = KEYMAP_UNMAPPABLE;
+        }
     }
+    return entry;
+}
 
-    int eventsAdded = 0;
+// ----------------------------------------------------------------------------
+// Encoding cost model (Hybrid mode)
+//
+// A VK character costs 2 events plus Shift transitions, a Unicode packet always
+// costs 2. Which is cheaper depends on the target's per-event latency for each
+// encoding, and Unicode is only an option for character classes the target is
+// known to deliver intact. The planner picks the cheaper reliable encoding for
+// each run of same-class characters.
+// ----------------------------------------------------------------------------
+
+enum class CharClass : BYTE {
+    Letter,
+    Digit,
+    Space,
+    Symbol,     // ASCII punctuation
+    NonAscii
+};
+
+inline BYTE CharClassBit(CharClass cls) {
+    return static_cast<BYTE>(1 << static_cast<int>(cls));
+}
+
+const BYTE CHARCLASS_ALL = 0x1F;
+
+inline CharClass ClassifyChar(wchar_t ch) {
+    if (ch >= 0x80) return CharClass::NonAscii;
+    if ((ch >= L'a' && ch <= L'z') || (ch >= L'A' && ch <= L'Z')) return CharClass::Letter;
+    if (ch >= L'0' && ch <= L'9') return CharClass::Digit;
+    if (ch == L' ' || ch == L'\t') return CharClass::Space;
+    return CharClass::Symbol;
+}
+
+struct EncodingCost {
+    double vkEventMs;        // Latency per scancode event
+    double unicodeEventMs;   // Latency per Unicode packet event
+    BYTE unicodeReliable;    // CharClassBit mask delivered intact as Unicode
+};
 
-    // Press Shift if needed
-    if (mapping.needsShift) {
-        INPUT shiftDown = {};
-        shiftDown.type = INPUT_KEYBOARD;
-        shiftDown.ki.wVk = VK_SHIFT;
-        shiftDown.ki.wScan = static_cast<WORD>(MapVirtualKeyW(VK_SHIFT, MAPVK_VK_TO_VSC));
-        shiftDown.ki.dwFlags = KEYEVENTF_SCANCODE;
-        buffer.push_back(shiftDown);
-        eventsAdded++;
+EncodingCost GetEncodingCost(TargetClass target) {
+    switch (target) {
+        case TargetClass::Local:
+            // Both encodings are delivered in-process at the same cost
+            return {0.05, 0.05, CHARCLASS_ALL};
+        case TargetClass::Rdp:
+            // Unicode PDUs are larger; symbols are remapped by some remote apps
+            return {1.0, 1.2, static_cast<BYTE>(CharClassBit(CharClass::Letter) |
+                                               CharClassBit(CharClass::Digit) |
+                                               CharClassBit(CharClass::NonAscii))};
+        case TargetClass::Citrix:
+            // ICA drops or garbles ASCII Unicode packets; only used for unmappable chars
+            return {1.5, 2.0, CharClassBit(CharClass::NonAscii)};
+        case TargetClass::Vnc:
+        case TargetClass::Browser:
+        default:
+            // Keysym translation: scancodes only
+            return {1.0, 1.0, CharClassBit(CharClass::NonAscii)};
     }
+}
+
+// Append character using KEYEVENTF_UNICODE (no modifiers involved)
+void AppendUnicodeCharacterOps(KeystrokePlan& plan, wchar_t c) {
+    AppendKeyOp(plan, c, KOP_UNICODE);
+    AppendKeyOp(plan, c, KOP_UNICODE | KOP_KEYUP);
+}
 
-    // Key down
-    INPUT down = {};
-    down.type = INPUT_KEYBOARD;
-    down.ki.wVk = mapping.vk;
-    down.ki.wScan = mapping.scancode;
-    down.ki.dwFlags = KEYEVENTF_SCANCODE;
-    buffer.push_back(down);
-    eventsAdded++;
+// Append character using its hardware scancode
+// Shift is held across a run of shifted characters; shiftHeld tracks it between calls
+// Returns number of ops added (2 for simple char, 3 when Shift changes state)
+int AppendVKCharacterOps(KeystrokePlan& plan, wchar_t ch, LayoutKeyTable& keys, bool& shiftHeld) {
+    const KeyMapEntry& key = LookupKey(keys, ch);
+    if (key.state != KEYMAP_MAPPABLE) {
+        return 0;  // Caller should fall back to Unicode
+    }
 
-    // Key up
-    INPUT up = {};
-    up.type = INPUT_KEYBOARD;
-    up.ki.wVk = mapping.vk;
-    up.ki.wScan = mapping.scancode;
-    up.ki.dwFlags = KEYEVENTF_SCANCODE | KEYEVENTF_KEYUP;
-    buffer.push_back(up);
-    eventsAdded++;
+    bool needsShift = (key.modifiers != 0);
+    int count = 2;
 
-    // Release Shift if pressed
-    if (mapping.needsShift) {
-        INPUT shiftUp = {};
-        shiftUp.type = INPUT_KEYBOARD;
-        shiftUp.ki.wVk = VK_SHIFT;
-        shiftUp.ki.wScan = static_cast<WORD>(MapVirtualKeyW(VK_SHIFT, MAPVK_VK_TO_VSC));
-        shiftUp.ki.dwFlags = KEYEVENTF_SCANCODE | KEYEVENTF_KEYUP;
-        buffer.push_back(shiftUp);
-        eventsAdded++;
+    if (needsShift != shiftHeld) {
+        AppendKeyOp(plan, keys.shiftScancode, KOP_SHIFT | (needsShift ? 0 : KOP_KEYUP));
+        shiftHeld = needsShift;
+        count++;
     }
+    AppendKeyOp(plan, key.scancode, 0);
+    AppendKeyOp(plan, key.scancode, KOP_KEYUP);
+
+    return count;
+}
 
-    return eventsAdded;
+// Release a Shift held over from a run of shifted characters
+// Required before Enter, Unicode fallback and the end of the plan
+void ReleaseHeldShift(KeystrokePlan& plan, LayoutKeyTable& keys, bool& shiftHeld) {
+    if (!shiftHeld) return;
+    AppendKeyOp(plan, keys.shiftScancode, KOP_SHIFT | KOP_KEYUP);
+    shiftHeld = false;
 }
 
 // Append character using appropriate mode
-// Returns true if character was added, false if skipped (should not happen)
-bool AppendCharacterWithMode(std::vector<INPUT>& buffer, wchar_t ch,
-                             InjectionMode mode, HKL layout) {
+void AppendCharacterWithMode(KeystrokePlan& plan, wchar_t ch, InjectionMode mode,
+                             LayoutKeyTable& keys, bool& shiftHeld) {
     switch (mode) {
         case InjectionMode::Unicode:
-            AppendCharacterInputs(buffer, ch);
-            return true;
-
-        case InjectionMode::VKScancode: {
-            int added = AppendVKCharacterInputs(buffer, ch, layout);
-            if (added == 0) {
-                // VK mapping failed - fall back to Unicode as last resort
-                AppendCharacterInputs(buffer, ch);
-            }
-            return true;
-        }
+            AppendUnicodeCharacterOps(plan, ch);
+            break;
 
-        case InjectionMode::Hybrid: {
-            // Try VK first, fall back to Unicode
-            int added = AppendVKCharacterInputs(buffer, ch, layout);
-            if (added == 0) {
-                AppendCharacterInputs(buffer, ch);
+        case InjectionMode::VKScancode:
+        case InjectionMode::Hybrid:
+            // Try VK first; Unicode is the last resort for unmappable characters
+            if (AppendVKCharacterOps(plan, ch, keys, shiftHeld) == 0) {
+                ReleaseHeldShift(plan, keys, shiftHeld);
+                AppendUnicodeCharacterOps(plan, ch);
             }
-            return true;
-        }
+            break;
 
         case InjectionMode::Auto:
         default:
             // Auto mode should be resolved before calling this
             // Default to Unicode
-            AppendCharacterInputs(buffer, ch);
-            return true;
+            AppendUnicodeCharacterOps(plan, ch);
+            break;
     }
 }
 
-// Flush accumulated INPUT events - loops until ALL events are sent
-// Returns true if all events were sent, false on unrecoverable failure
-// Optional eventsSent pointer to track total events successfully sent
-bool FlushInputs(std::vector<INPUT>& buffer, size_t* eventsSent = nullptr) {
-    if (buffer.empty()) return true;
+// Enter key using hardware scancode for maximum compatibility
+// Unicode CR/LF doesn't create line breaks in Scintilla-based editors
+// Using KEYEVENTF_SCANCODE forces hardware-level input that Scintilla handles correctly
+// Line-burst plans skip the newline pauses and only mark the end of the line
+void AppendEnterOps(KeystrokePlan& plan, bool crlf, bool lineBurst) {
+    if (lineBurst) {
+        AppendKeyOp(plan, 0x1C, 0);
+        AppendKeyOp(plan, 0x1C, KOP_KEYUP | KOP_CHAR_END | KOP_LINE_END | (crlf ? KOP_PAIR : 0));
+        plan.ops.back().pace = PaceClass::Line;
+        return;
+    }
 
-    UINT total = static_cast<UINT>(buffer.size());
-    UINT offset = 0;
-    int consecutiveFailures = 0;
+    // Pause before Enter; an Enter straight after another Enter keeps both pauses
+    if (!plan.ops.empty()) {
+        KeyOp& prev = plan.ops.back();
+        prev.pace = (prev.pace == PaceClass::NewlinePost) ? PaceClass::NewlineBoth
+                                                          : PaceClass::NewlinePre;
+    }
 
-    while (offset < total) {
-        UINT remaining = total - offset;
-        UINT sent = SendInput(remaining, buffer.data() + offset, sizeof(INPUT));
+    AppendKeyOp(plan, 0x1C, 0);  // Hardware scan code for Enter key
+    AppendKeyOp(plan, 0x1C, KOP_KEYUP | KOP_CHAR_END | KOP_LINE_END | (crlf ? KOP_PAIR : 0));
+    plan.ops.back().pace = PaceClass::NewlinePost;
+}
 
-        if (sent > 0) {
-            offset += sent;
-            if (eventsSent) *eventsSent += sent;
-            consecutiveFailures = 0;
-        } else {
-            // Complete failure - yield and retry
-            consecutiveFailures++;
-            if (consecutiveFailures >= MAX_RETRY_COUNT) {
-                buffer.clear();
-                return false;
-            }
-            Sleep(1);  // Real yield - allows target to drain input queue
-        }
+// Split after character i? Prefers a space near the limit; a hard split inside
+// a token only where the continuation joins tokens (bash '\', not PowerShell '`')
+bool ShouldSplitLine(std::wstring_view text, size_t i, wchar_t c, size_t column,
+                     const PacingConfig& config) {
+    if (config.lineSplitColumn <= 0 || !config.lineContinuation) return false;
+    if (i + 1 >= text.size() || text[i + 1] == L'\r' || text[i + 1] == L'\n') return false;
+
+    size_t limit = static_cast<size_t>(config.lineSplitColumn);
+    if (c == L' ' && column + LINE_SPLIT_SEEK >= limit) return true;
+    return (config.lineContinuation == L'\\' && column >= limit);
+}
+
+// Pace class for the character just planned, from its class and context
+// Unicode counts as risky only as a fallback - in Unicode mode every character uses it.
+// The shifted-symbol delay applies only when Shift is actually sent (not as a packet).
+PaceClass CharPaceClass(wchar_t c, wchar_t prev, InjectionMode mode, bool sentUnicode,
+                        LayoutKeyTable& keys) {
+    const KeyMapEntry& key = LookupKey(keys, c);
+    if (mode != InjectionMode::Unicode && key.state != KEYMAP_MAPPABLE) {
+        return PaceClass::CharUnicode;
+    }
+    if (!sentUnicode && ClassifyChar(c) == CharClass::Symbol && key.modifiers != 0) {
+        return PaceClass::CharShiftedSymbol;
     }
+    if (c == prev) return PaceClass::CharRepeat;
+    return PaceClass::Char;
+}
 
-    buffer.clear();
-    return true;
+// Hybrid: decide how to encode the run of same-class characters starting at start
+// Returns true to send the run as Unicode packets; runEnd receives the index after the run
+bool ChooseRunEncoding(std::wstring_view text, size_t start, LayoutKeyTable& keys,
+                       const EncodingCost& cost, bool shiftHeld, size_t& runEnd) {
+    wchar_t first = text[start];
+    CharClass cls = ClassifyChar(first);
+    const KeyMapEntry& firstKey = LookupKey(keys, first);
+    bool mappable = (firstKey.state == KEYMAP_MAPPABLE);
+    bool shifted = mappable && firstKey.modifiers != 0;
+
+    // A run ends at a newline or when class, mappability or Shift need changes
+    runEnd = start + 1;
+    while (runEnd < text.size()) {
+        wchar_t c = text[runEnd];
+        if (c == L'\r' || c == L'\n' || ClassifyChar(c) != cls) break;
+        const KeyMapEntry& key = LookupKey(keys, c);
+        if ((key.state == KEYMAP_MAPPABLE) != mappable) break;
+        if (mappable && (key.modifiers != 0) != shifted) break;
+        runEnd++;
+    }
+
+    if (!mappable) return true;  // Unicode is the only encoding
+    if (!(cost.unicodeReliable & CharClassBit(cls))) return false;
+
+    // VK: 2 events per char plus Shift press/release around a shifted run
+    // Unicode: 2 events per char plus releasing a Shift still held
+    double length = static_cast<double>(runEnd - start);
+    double vkEvents = 2.0 * length;
+    if (shifted) {
+        vkEvents += (shiftHeld ? 0 : 1) + 1;
+    } else if (shiftHeld) {
+        vkEvents += 1;
+    }
+    double unicodeEvents = 2.0 * length + (shiftHeld ? 1 : 0);
+
+    return unicodeEvents * cost.unicodeEventMs < vkEvents * cost.vkEventMs;
 }
 
-// Forward declarations for pacing
-struct DiagnosticState;
+// Estimated cost of a compiled plan on its target
+double PlanCostMs(const KeystrokePlan& plan, const EncodingCost& cost) {
+    double ms = 0.0;
+    for (const KeyOp& op : plan.ops) {
+        ms += (op.flags & KOP_UNICODE) ? cost.unicodeEventMs : cost.vkEventMs;
+    }
+    return ms;
+}
 
-// Pacing configuration for injection
-struct PacingConfig {
-    PacingStrategy strategy;
-    int perEventDelayMs;
-    int perCharDelayMs;
-    int lineStartGuardChars;
-    int lineStartGuardMs;
-    int baseKeystrokeDelayMs;  // From UI setting
-};
+// Reference cost of sending everything mappable as scancodes (Shift coalesced)
+double VKOnlyCostMs(std::wstring_view text, LayoutKeyTable& keys, const EncodingCost& cost) {
+    double ms = 0.0;
+    bool shiftHeld = false;
 
-// Get default pacing config based on target type
-PacingConfig GetDefaultPacingConfig(bool isRemote) {
-    PacingConfig config = {};
-    config.perEventDelayMs = PER_EVENT_DELAY_MS;
-    config.perCharDelayMs = PER_CHAR_DELAY_MS;
-    config.lineStartGuardChars = LINE_START_GUARD_CHARS;
-    config.lineStartGuardMs = LINE_START_GUARD_MS;
-    config.baseKeystrokeDelayMs = g_app.keystrokeDelayMs;
+    for (size_t i = 0; i < text.size(); ++i) {
+        wchar_t c = text[i];
+        if (c == L'\r' && i + 1 < text.size() && text[i + 1] == L'\n') ++i;
 
-    if (isRemote) {
-        config.strategy = PacingStrategy::PerCharacter;
-    } else {
-        config.strategy = PacingStrategy::Burst;
+        if (c == L'\n' || c == L'\r') {
+            ms += ((shiftHeld ? 1 : 0) + 2) * cost.vkEventMs;
+            shiftHeld = false;
+            continue;
+        }
+
+        const KeyMapEntry& key = LookupKey(keys, c);
+        if (key.state == KEYMAP_MAPPABLE) {
+            bool needsShift = (key.modifiers != 0);
+            ms += (2 + (needsShift != shiftHeld ? 1 : 0)) * cost.vkEventMs;
+            shiftHeld = needsShift;
+        } else {
+            ms += (shiftHeld ? 1 : 0) * cost.vkEventMs + 2 * cost.unicodeEventMs;
+            shiftHeld = false;
+        }
     }
 
-    return config;
+    if (shiftHeld) ms += cost.vkEventMs;
+    return ms;
 }
 
-// Flush with per-event pacing - sends events one at a time with delays
-// Returns number of events successfully sent
-size_t FlushInputsWithPacing(std::vector<INPUT>& buffer, const PacingConfig& config,
-                             DiagnosticState* diag) {
-    if (buffer.empty()) return 0;
+// Compile normalized text into a keystroke plan (the text is read in place)
+// startColumn continues a line the previous chunk was cut in (splitting, guards)
+void BuildKeystrokePlan(KeystrokePlan& plan, std::wstring_view text, InjectionMode mode,
+                        HKL layout, TargetClass target, const PacingConfig& config,
+                        size_t startColumn = 0) {
+    plan.ops.clear();
+    plan.ops.reserve(text.size() * 2 + 2);
+    plan.unicodeChars = 0;
+    plan.transliteratedChars = 0;
+
+    LayoutKeyTable& keys = GetLayoutKeyTable(layout);
+    EncodingCost cost = GetEncodingCost(target);
+
+    // Hybrid encodes run by run; runUnicode applies until runEnd
+    size_t runEnd = 0;
+    bool runUnicode = false;
+
+    // Burst sends chunks of CHUNK_SIZE characters, line-burst whole lines;
+    // other strategies pace every character
+    bool lineBurst = (config.strategy == PacingStrategy::LineBurst);
+    size_t chunkSize = (config.strategy == PacingStrategy::Burst) ? CHUNK_SIZE : 1;
+    size_t charsInChunk = 0;
+    size_t charsSinceNewline = startColumn;  // For line-start guard and splitting
+    bool shiftHeld = false;        // Shift down from the previous VK character
+    wchar_t prevChar = 0;          // For repeated-key pacing (reset at newlines)
 
-    size_t sent = 0;
-    int consecutiveFailures = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        wchar_t c = text[i];
 
-    for (size_t i = 0; i < buffer.size(); i++) {
-        UINT result = SendInput(1, &buffer[i], sizeof(INPUT));
+        // CRLF collapses to a single Enter
+        bool crlf = (c == L'\r' && i + 1 < text.size() && text[i + 1] == L'\n');
+        if (crlf) ++i;
 
-        if (result > 0) {
-            sent++;
-            consecutiveFailures = 0;
+        if (c == L'\n' || c == L'\r') {
+            ReleaseHeldShift(plan, keys, shiftHeld);
+            AppendEnterOps(plan, crlf, lineBurst);
+            charsInChunk = 0;
+            charsSinceNewline = 0;
+            prevChar = 0;
+            continue;
+        }
+
+        // A surrogate pair is one character: no layout has a key for it, so both
+        // halves go out as Unicode packets with a single boundary after them
+        bool pair = (IS_HIGH_SURROGATE(c) && i + 1 < text.size() && IS_LOW_SURROGATE(text[i + 1]));
 
-            // Per-event delay
-            if (config.strategy == PacingStrategy::PerEvent && config.perEventDelayMs > 0) {
-                Sleep(config.perEventDelayMs);
+        // A character the layout lacks is typed as its transliteration when enabled
+        const wchar_t* spelling = nullptr;
+        if (!pair && config.transliterate && mode != InjectionMode::Unicode &&
+            LookupKey(keys, c).state != KEYMAP_MAPPABLE) {
+            spelling = textnormalize::Transliteration(c);
+        }
+
+        size_t firstOp = plan.ops.size();
+        wchar_t typed = c;  // Last character actually typed (pacing)
+        if (pair) {
+            ReleaseHeldShift(plan, keys, shiftHeld);
+            AppendUnicodeCharacterOps(plan, c);
+            AppendUnicodeCharacterOps(plan, text[++i]);
+            plan.unicodeChars++;
+        } else if (spelling) {
+            for (const wchar_t* p = spelling; *p; ++p) {
+                AppendCharacterWithMode(plan, *p, mode, keys, shiftHeld);
+                typed = *p;
+            }
+            plan.transliteratedChars++;
+        } else if (mode == InjectionMode::Hybrid) {
+            if (i >= runEnd) {
+                runUnicode = ChooseRunEncoding(text, i, keys, cost, shiftHeld, runEnd);
+            }
+            if (runUnicode) {
+                ReleaseHeldShift(plan, keys, shiftHeld);
+                AppendUnicodeCharacterOps(plan, c);
+                plan.unicodeChars++;
+            } else {
+                AppendCharacterWithMode(plan, c, mode, keys, shiftHeld);
             }
         } else {
-            consecutiveFailures++;
-            if (consecutiveFailures >= MAX_RETRY_COUNT) {
-                break;  // Abort on repeated failures
+            AppendCharacterWithMode(plan, c, mode, keys, shiftHeld);
+        }
+        plan.ops.back().flags |= KOP_CHAR_END | (pair ? KOP_PAIR : 0);
+        charsInChunk++;
+        charsSinceNewline++;
+
+        if (config.strategy == PacingStrategy::PerEvent) {
+            for (size_t op = firstOp; op + 1 < plan.ops.size(); op++) {
+                plan.ops[op].pace = PaceClass::Event;
             }
-            Sleep(1);
-            i--;  // Retry this event
+        }
+
+        // Chunk boundary - Burst pauses per chunk, paced strategies per character class;
+        // line-start guard applies to the first few chars after newline
+        if (!lineBurst && charsInChunk >= chunkSize) {
+            KeyOp& last = plan.ops.back();
+            bool lineStart = (charsSinceNewline <= static_cast<size_t>(config.lineStartGuardChars));
+            bool sentUnicode = (last.flags & KOP_UNICODE) != 0;
+            last.pace = (config.strategy == PacingStrategy::Burst)
+                            ? PaceClass::Char
+                            : CharPaceClass(typed, prevChar, mode, sentUnicode, keys);
+            if (lineStart) {
+                last.flags |= KOP_LINE_START;
+            } else if (config.strategy == PacingStrategy::TokenBucket &&
+                       last.pace == PaceClass::Char &&
+                       (config.columnRampStart == 0 ||
+                        charsSinceNewline <= static_cast<size_t>(config.columnRampStart))) {
+                // The bucket paces plain characters; they batch with their neighbours
+                last.pace = PaceClass::None;
+            }
+            charsInChunk = 0;
+        }
+        prevChar = typed;
+
+        // Split over-long lines with the shell's continuation character
+        if (ShouldSplitLine(text, i, c, charsSinceNewline, config)) {
+            AppendCharacterWithMode(plan, config.lineContinuation, mode, keys, shiftHeld);
+            ReleaseHeldShift(plan, keys, shiftHeld);
+            AppendEnterOps(plan, false, lineBurst);
+            plan.ops.back().flags &= ~KOP_CHAR_END;  // Not a source character
+            charsInChunk = 0;
+            charsSinceNewline = 0;
+            prevChar = 0;
         }
     }
 
-    buffer.clear();
-    return sent;
+    ReleaseHeldShift(plan, keys, shiftHeld);
+
+    plan.sourceUnits = text.size();
+    plan.startColumn = startColumn;
+    plan.endColumn = charsSinceNewline;
+    plan.textHash = HashText(text.data(), text.size());
+    plan.layout = layout;
+    plan.mode = mode;
+    plan.target = target;
+    plan.strategy = config.strategy;
+    plan.lineStartGuardChars = config.lineStartGuardChars;
+    plan.lineSplitColumn = config.lineSplitColumn;
+    plan.lineContinuation = config.lineContinuation;
+    plan.transliterate = config.transliterate;
+    plan.valid = true;
+
+    plan.costMs = PlanCostMs(plan, cost);
+    plan.vkOnlyCostMs = (mode == InjectionMode::Hybrid) ? VKOnlyCostMs(text, keys, cost)
+                                                         : plan.costMs;
 }
 
-// Append character using KEYEVENTF_UNICODE (no modifiers involved)
-void AppendCharacterInputs(std::vector<INPUT>& buffer, wchar_t c) {
-    INPUT down = {};
-    down.type = INPUT_KEYBOARD;
-    down.ki.wScan = c;
-    down.ki.dwFlags = KEYEVENTF_UNICODE;
-    buffer.push_back(down);
+// Reuse a previously compiled plan when nothing it depends on has changed
+bool IsPlanCurrent(const KeystrokePlan& plan, std::wstring_view text, InjectionMode mode,
+                   HKL layout, TargetClass target, const PacingConfig& config,
+                   size_t startColumn = 0) {
+    return plan.valid &&
+           plan.sourceUnits == text.size() &&
+           plan.startColumn == startColumn &&
+           plan.layout == layout &&
+           plan.mode == mode &&
+           plan.target == target &&
+           plan.strategy == config.strategy &&
+           plan.lineStartGuardChars == config.lineStartGuardChars &&
+           plan.lineSplitColumn == config.lineSplitColumn &&
+           plan.lineContinuation == config.lineContinuation &&
+           plan.transliterate == config.transliterate &&
+           plan.textHash == HashText(text.data(), text.size());
+}
 
-    INPUT up = {};
-    up.type = INPUT_KEYBOARD;
-    up.ki.wScan = c;
-    up.ki.dwFlags = KEYEVENTF_UNICODE | KEYEVENTF_KEYUP;
-    buffer.push_back(up);
+// Expand a plan op into the INPUT event it stands for
+inline void ExpandKeyOp(const KeyOp& op, INPUT& input) {
+    input.type = INPUT_KEYBOARD;
+    input.ki.wVk = 0;  // Ignored with KEYEVENTF_SCANCODE / KEYEVENTF_UNICODE
+    input.ki.wScan = op.code;
+    input.ki.dwFlags = (op.flags & KOP_UNICODE) ? KEYEVENTF_UNICODE : KEYEVENTF_SCANCODE;
+    if (op.flags & KOP_KEYUP) input.ki.dwFlags |= KEYEVENTF_KEYUP;
 }
 
-// Send Enter key using hardware scancode for maximum compatibility
-// Unicode CR/LF doesn't create line breaks in Scintilla-based editors
-// Using KEYEVENTF_SCANCODE forces hardware-level input that Scintilla handles correctly
-void SendEnterKey() {
-    INPUT inputs[2] = {};
+// Flush accumulated INPUT events - loops until ALL events are sent
+// Returns true if all events were sent, false on unrecoverable failure
+// Optional eventsSent pointer to track total events successfully sent
+// Optional partial flag is set when any SendInput call accepted fewer events than offered
+bool FlushInputs(INPUT* inputs, UINT count, size_t* eventsSent = nullptr,
+                 bool* partial = nullptr) {
+    UINT offset = 0;
+    int consecutiveFailures = 0;
 
-    // Key down - use scancode mode for hardware-level simulation
-    inputs[0].type = INPUT_KEYBOARD;
-    inputs[0].ki.wVk = 0;       // Must be 0 when using KEYEVENTF_SCANCODE
-    inputs[0].ki.wScan = 0x1C;  // Hardware scan code for Enter key
-    inputs[0].ki.dwFlags = KEYEVENTF_SCANCODE;
+    while (offset < count) {
+        UINT remaining = count - offset;
+        UINT sent = SendInput(remaining, inputs + offset, sizeof(INPUT));
+        if (sent < remaining && partial) *partial = true;
 
-    // Key up
-    inputs[1].type = INPUT_KEYBOARD;
-    inputs[1].ki.wVk = 0;
-    inputs[1].ki.wScan = 0x1C;
-    inputs[1].ki.dwFlags = KEYEVENTF_SCANCODE | KEYEVENTF_KEYUP;
+        if (sent > 0) {
+            offset += sent;
+            if (eventsSent) *eventsSent += sent;
+            consecutiveFailures = 0;
+        } else {
+            // Complete failure - yield and retry
+            consecutiveFailures++;
+            if (consecutiveFailures >= MAX_RETRY_COUNT) {
+                return false;
+            }
+            Sleep(1);  // Real yield - allows target to drain input queue
+        }
+    }
 
-    // Send both events atomically
-    SendInput(2, inputs, sizeof(INPUT));
+    return true;
 }
 
-// Drain the input queue by yielding CPU time repeatedly
-// This ensures the target app has time to process pending input before we continue
-void DrainInputQueue() {
-    // Multiple yields with longer sleeps to let the target process its message queue
-    // SwitchToThread yields to any ready thread, Sleep(1) allows scheduler to run others
-    for (int i = 0; i < 5; i++) {
-        SwitchToThread();
-        Sleep(2);
+// Injected-event hook (installed by the hook thread below)
+size_t GetHookEventCount();
+bool IsDiagnosticHookInstalled();
+
+// Backpressure for local targets
+// Waits only while the target is still behind, at most IDLE_WAIT_MS. With the
+// injected-event hook installed the backlog is what we submitted minus what
+// the hook has seen; otherwise a WM_NULL round trip (SMTO_ABORTIFHUNG, so a
+// hung target can't stall us) shows when the target thread pumps again.
+// GetQueueStatus is no use here - it only reports the calling thread's queue.
+struct TargetBackpressure {
+    HWND hwnd;
+    bool hookProbe;          // Backlog from the hook count, else WM_NULL
+    size_t submitted;        // Events submitted since construction
+    size_t hookBase;         // Hook count corresponding to zero submitted
+
+    // Statistics
+    size_t checks;
+    size_t busyChecks;
+    double waitedMs;
+    double maxWaitMs;
+
+    explicit TargetBackpressure(HWND target)
+        : hwnd(target), hookProbe(IsDiagnosticHookInstalled()),
+          submitted(0), hookBase(GetHookEventCount()),
+          checks(0), busyChecks(0), waitedMs(0.0), maxWaitMs(0.0) {}
+
+    void OnSubmitted(UINT events) {
+        submitted += events;
     }
-}
 
-// Get process ID of foreground window
-DWORD GetForegroundProcessId() {
-    HWND fg = GetForegroundWindow();
-    if (!fg) return 0;
-    DWORD pid = 0;
-    GetWindowThreadProcessId(fg, &pid);
-    return pid;
-}
+    // Submitted events the hook hasn't seen yet
+    size_t Backlog() {
+        size_t observed = GetHookEventCount() - hookBase;
+        if (observed > submitted) {
+            // Foreign injected input (or our modifier reset) - rebase
+            hookBase += observed - submitted;
+            observed = submitted;
+        }
+        return submitted - observed;
+    }
 
-// Wait for target process to become idle (finished processing input)
-// Returns true if idle or on error, false on timeout
-bool WaitForTargetIdle(DWORD pid, DWORD maxWaitMs) {
-    if (pid == 0) return true;
+    // Wait until the target has caught up, at most IDLE_WAIT_MS
+    void Wait(PacingScheduler& scheduler) {
+        checks++;
+        LONGLONG start = QpcNow();
+
+        if (hookProbe) {
+            if (Backlog() == 0) return;
+            busyChecks++;
+            LONGLONG limit = start + MsToQpc(IDLE_WAIT_MS);
+            while (Backlog() > 0 && QpcNow() < limit && !scheduler.Interrupted()) {
+                scheduler.WaitUntil(QpcNow() + MsToQpc(BACKPRESSURE_POLL_MS));
+            }
+            // Events the hook missed (it timed out) shouldn't stall every later line
+            submitted -= Backlog();
+        } else {
+            DWORD_PTR result = 0;
+            if (!hwnd) return;
+            SendMessageTimeoutW(hwnd, WM_NULL, 0, 0, SMTO_ABORTIFHUNG, IDLE_WAIT_MS, &result);
+            if (QpcToMs(QpcNow() - start) > BACKPRESSURE_POLL_MS) busyChecks++;
+        }
 
-    HANDLE hProcess = OpenProcess(SYNCHRONIZE, FALSE, pid);
-    if (!hProcess) return true;  // Can't open = assume ready
+        double ms = QpcToMs(QpcNow() - start);
+        waitedMs += ms;
+        if (ms > maxWaitMs) maxWaitMs = ms;
+    }
+};
 
-    DWORD result = WaitForInputIdle(hProcess, maxWaitMs);
-    CloseHandle(hProcess);
+// Drain the input queue by yielding CPU time repeatedly
+// This ensures the target app has time to process pending input before we continue
+// Local targets with backpressure wait only while input is still queued
+void DrainInputQueue(PacingScheduler& scheduler, TargetBackpressure* backpressure) {
+    if (backpressure) {
+        backpressure->Wait(scheduler);
+        return;
+    }
 
-    // 0 = success (idle), WAIT_TIMEOUT = timeout, WAIT_FAILED = error
-    return (result != WAIT_TIMEOUT);
+    // Multiple yields with short paced waits to let the target process its message queue
+    // SwitchToThread yields to any ready thread, the wait lets the scheduler run others
+    for (int i = 0; i < 5; i++) {
+        SwitchToThread();
+        scheduler.Pause(2);
+    }
 }
 
+// Injection held because another window took the foreground
+struct FocusPause {
+    std::wstring className;   // Window that took the foreground
+    size_t unitsSent;         // Chars sent when the pause started
+    double pausedMs;
+};
+
 // Diagnostic state for injection debugging
 struct DiagnosticState {
     size_t totalEventsAttempted;
@@ -815,7 +1842,10 @@ struct DiagnosticState {
     size_t totalEventsFailed;
     size_t totalCharsSent;
     size_t totalCharsRequested;
-    std::vector<std::pair<DWORD, std::wstring>> foregroundChanges;
+    std::vector<FocusPause> focusPauses;
+    size_t userPauses;         // Pause hotkey holds
+    double userPausedMs;
+    size_t resumedFromChars;   // Paste continued an interrupted one from here
     std::vector<std::wstring> errors;
     DWORD startTime;
     DWORD endTime;
@@ -825,21 +1855,123 @@ struct DiagnosticState {
     std::wstring targetClassName;
     bool targetIsRemote;
 
+    // Keystroke plan (streamed pastes are planned chunk by chunk)
+    size_t planOps;            // Largest chunk plan
+    size_t planChunks;
+    double planBuildMs;
+    bool planCached;
+
+    size_t transliteratedChars;
+
+    // Hybrid encoding cost (estimated, see GetEncodingCost)
+    size_t encodingUnicodeChars;
+    double encodingCostMs;
+    double encodingVKOnlyCostMs;
+
+    // Pacing accuracy
+    size_t pacingWaits;
+    size_t pacingLateWaits;
+    double pacingScheduledMs;
+    double pacingAvgOvershootMs;
+    double pacingMaxOvershootMs;
+    bool pacingHighResTimer;
+
+    // Local target backpressure
+    bool backpressureUsed;
+    bool backpressureHookProbe;
+    size_t backpressureChecks;
+    size_t backpressureBusy;
+    double backpressureWaitedMs;
+    double backpressureMaxWaitMs;
+
+    // SendInput batch tuning
+    size_t batchInitialLimit;
+    size_t batchFinalLimit;
+    size_t batchCap;
+    size_t batchShrinks;
+    size_t batchGrows;
+    bool batchLearned;
+
+    // Latency (QPC stamps): trigger = hotkey or countdown end, focus = target settled
+    LONGLONG triggerQpc;
+    LONGLONG focusQpc;
+    LONGLONG firstEventQpc;
+    double chordWaitMs;        // Hotkey paste waiting for Ctrl+Alt to be released (< 0 = no wait)
+    double abortLatencyMs;     // ESC / cancel to injection stopped (< 0 = not aborted)
+
+    // Learned target profile
+    std::wstring profileKey;
+    bool profileLoaded;
+    int profilePastes;
+
+    // Token bucket
+    bool bucketUsed;
+    int bucketDepth;
+    int bucketRatePerSec;
+    size_t bucketWaits;
+    double bucketWaitedMs;
+
+    // Adaptive pacing
+    bool adaptiveUsed;
+    double adaptiveFinalDelayMs;
+    double adaptiveMinDelayMs;
+    double adaptiveMaxDelayMs;
+    double adaptiveAvgLagMs;
+    size_t adaptiveIncreases;
+    size_t adaptiveBackoffs;
+    size_t adaptiveMissingEvents;
+
     DiagnosticState() : totalEventsAttempted(0), totalEventsSent(0),
                         totalEventsFailed(0), totalCharsSent(0),
-                        totalCharsRequested(0), startTime(0), endTime(0),
-                        targetIsRemote(false) {}
-
-    void RecordForegroundChange(HWND hwnd) {
+                        totalCharsRequested(0), userPauses(0), userPausedMs(0.0),
+                        resumedFromChars(0), startTime(0), endTime(0),
+                        targetIsRemote(false), planOps(0), planChunks(0), planBuildMs(0.0),
+                        planCached(false), transliteratedChars(0), encodingUnicodeChars(0),
+                        encodingCostMs(0.0), encodingVKOnlyCostMs(0.0), pacingWaits(0), pacingLateWaits(0),
+                        pacingScheduledMs(0.0), pacingAvgOvershootMs(0.0),
+                        pacingMaxOvershootMs(0.0), pacingHighResTimer(false),
+                        backpressureUsed(false), backpressureHookProbe(false),
+                        backpressureChecks(0), backpressureBusy(0),
+                        backpressureWaitedMs(0.0), backpressureMaxWaitMs(0.0),
+                        batchInitialLimit(0), batchFinalLimit(0), batchCap(0),
+                        batchShrinks(0), batchGrows(0), batchLearned(false),
+                        triggerQpc(0), focusQpc(0), firstEventQpc(0), chordWaitMs(-1.0), abortLatencyMs(-1.0),
+                        profileLoaded(false), profilePastes(0),
+                        bucketUsed(false), bucketDepth(0), bucketRatePerSec(0),
+                        bucketWaits(0), bucketWaitedMs(0.0),
+                        adaptiveUsed(false), adaptiveFinalDelayMs(0.0),
+                        adaptiveMinDelayMs(0.0), adaptiveMaxDelayMs(0.0),
+                        adaptiveAvgLagMs(0.0), adaptiveIncreases(0),
+                        adaptiveBackoffs(0), adaptiveMissingEvents(0) {}
+
+    void RecordFocusPause(HWND foreground, size_t unitsSent, double pausedMs) {
         wchar_t className[256] = {};
-        if (hwnd) GetClassNameW(hwnd, className, 256);
-        foregroundChanges.push_back({GetTickCount(), className});
+        if (foreground) GetClassNameW(foreground, className, 256);
+        focusPauses.push_back({className, unitsSent, pausedMs});
     }
 
     void RecordError(const std::wstring& error) {
         errors.push_back(error);
     }
 
+    void RecordBackpressure(const TargetBackpressure& backpressure) {
+        backpressureUsed = true;
+        backpressureHookProbe = backpressure.hookProbe;
+        backpressureChecks = backpressure.checks;
+        backpressureBusy = backpressure.busyChecks;
+        backpressureWaitedMs = backpressure.waitedMs;
+        backpressureMaxWaitMs = backpressure.maxWaitMs;
+    }
+
+    void RecordPacing(const PacingScheduler& scheduler) {
+        pacingWaits = scheduler.waits;
+        pacingLateWaits = scheduler.lateWaits;
+        pacingScheduledMs = scheduler.scheduledMs;
+        pacingAvgOvershootMs = scheduler.waits ? scheduler.totalOvershootMs / scheduler.waits : 0.0;
+        pacingMaxOvershootMs = scheduler.maxOvershootMs;
+        pacingHighResTimer = scheduler.highResolution;
+    }
+
     std::wstring GetSummary(bool forMessageBox = false) {
         std::wstring summary;
         std::wstring nl = forMessageBox ? L"\n" : L"\r\n";
@@ -879,6 +2011,106 @@ struct DiagnosticState {
         summary += L"Events: " + std::to_wstring(totalEventsSent) + L" / " +
                    std::to_wstring(totalEventsAttempted) + L" sent" + nl;
 
+        if (resumedFromChars > 0) {
+            summary += L"Resumed from character " + std::to_wstring(resumedFromChars) + nl;
+        }
+        if (userPauses > 0) {
+            wchar_t pauseStr[96];
+            swprintf_s(pauseStr, L"Paused: %zu time(s), %.1f s total", userPauses, userPausedMs / 1000.0);
+            summary += pauseStr + nl;
+        }
+
+        wchar_t planStr[128];
+        if (planChunks > 1) {
+            swprintf_s(planStr, L"Plan: %zu chunks, up to %zu ops (%.1f KB), built in %.2f ms",
+                planChunks, planOps, planOps * sizeof(KeyOp) / 1024.0, planBuildMs);
+        } else if (planCached) {
+            swprintf_s(planStr, L"Plan: %zu ops (%.1f KB, cached)",
+                planOps, planOps * sizeof(KeyOp) / 1024.0);
+        } else {
+            swprintf_s(planStr, L"Plan: %zu ops (%.1f KB), built in %.2f ms",
+                planOps, planOps * sizeof(KeyOp) / 1024.0, planBuildMs);
+        }
+        summary += planStr + nl;
+
+        if (transliteratedChars > 0) {
+            summary += L"Transliterated: " + std::to_wstring(transliteratedChars) +
+                       L" chars the layout can't type" + nl;
+        }
+
+        if (encodingVKOnlyCostMs > 0.0) {
+            wchar_t encodingStr[160];
+            swprintf_s(encodingStr, L"Encoding: %zu chars as Unicode, est. %.0f ms vs %.0f ms pure VK (%.1f%% saved)",
+                encodingUnicodeChars, encodingCostMs, encodingVKOnlyCostMs,
+                100.0 * (encodingVKOnlyCostMs - encodingCostMs) / encodingVKOnlyCostMs);
+            summary += encodingStr + nl;
+        }
+
+        if (pacingWaits > 0) {
+            wchar_t pacingStr[160];
+            swprintf_s(pacingStr, L"Pacing: %zu waits, %.0f ms scheduled, overshoot avg %.3f / max %.2f ms, %zu late (%s)",
+                pacingWaits, pacingScheduledMs, pacingAvgOvershootMs, pacingMaxOvershootMs,
+                pacingLateWaits, pacingHighResTimer ? L"high-res timer" : L"1 ms timer");
+            summary += pacingStr + nl;
+        }
+
+        if (backpressureUsed) {
+            wchar_t backpressureStr[160];
+            swprintf_s(backpressureStr, L"Backpressure: %s, %zu check(s), %zu busy, %.1f ms waited (max %.1f ms)",
+                backpressureHookProbe ? L"hook backlog" : L"WM_NULL round trip",
+                backpressureChecks, backpressureBusy, backpressureWaitedMs, backpressureMaxWaitMs);
+            summary += backpressureStr + nl;
+        }
+
+        if (batchCap > 0) {
+            wchar_t batchStr[160];
+            swprintf_s(batchStr, L"Batching: %zu -> %zu events per SendInput (cap %zu), %zu shrink(s), %zu grow(s)",
+                batchInitialLimit, batchFinalLimit, batchCap, batchShrinks, batchGrows);
+            summary += batchStr + nl;
+        }
+
+        if (triggerQpc != 0 && firstEventQpc != 0) {
+            wchar_t latencyStr[200];
+            if (chordWaitMs >= 0.0) {
+                swprintf_s(latencyStr, L"Latency: %.1f ms trigger to first event (focus %.1f ms, hotkey release %.1f ms, setup %.1f ms)",
+                    QpcToMs(firstEventQpc - triggerQpc), QpcToMs(focusQpc - triggerQpc), chordWaitMs,
+                    QpcToMs(firstEventQpc - focusQpc) - chordWaitMs);
+            } else {
+                swprintf_s(latencyStr, L"Latency: %.1f ms trigger to first event (focus %.1f ms, setup %.1f ms)",
+                    QpcToMs(firstEventQpc - triggerQpc), QpcToMs(focusQpc - triggerQpc),
+                    QpcToMs(firstEventQpc - focusQpc));
+            }
+            summary += latencyStr + nl;
+        }
+
+        if (abortLatencyMs >= 0.0) {
+            wchar_t abortStr[96];
+            swprintf_s(abortStr, L"Abort: injection stopped %.1f ms after ESC", abortLatencyMs);
+            summary += abortStr + nl;
+        }
+
+        if (!profileKey.empty()) {
+            summary += L"Profile: " + profileKey;
+            summary += profileLoaded ? L" (learned from " + std::to_wstring(profilePastes) + L" paste(s))"
+                                     : std::wstring(L" (new, class defaults)");
+            summary += nl;
+        }
+
+        if (bucketUsed) {
+            wchar_t bucketStr[160];
+            swprintf_s(bucketStr, L"Token bucket: depth %d, %d events/s, %zu wait(s) totalling %.0f ms",
+                bucketDepth, bucketRatePerSec, bucketWaits, bucketWaitedMs);
+            summary += bucketStr + nl;
+        }
+
+        if (adaptiveUsed) {
+            wchar_t adaptiveStr[200];
+            swprintf_s(adaptiveStr, L"Adaptive: %.1f ms/char final (%.1f-%.1f), lag avg %.1f ms, %zu up / %zu back-off, %zu missing",
+                adaptiveFinalDelayMs, adaptiveMinDelayMs, adaptiveMaxDelayMs, adaptiveAvgLagMs,
+                adaptiveIncreases, adaptiveBackoffs, adaptiveMissingEvents);
+            summary += adaptiveStr + nl;
+        }
+
         DWORD duration = endTime - startTime;
         summary += L"Duration: " + std::to_wstring(duration) + L" ms";
         if (duration > 0 && totalCharsSent > 0) {
@@ -890,12 +2122,18 @@ struct DiagnosticState {
         summary += nl;
 
         // Issues
-        if (!foregroundChanges.empty() || !errors.empty()) {
+        if (!focusPauses.empty() || !errors.empty()) {
             summary += nl + L"Issues:" + nl;
-            if (!foregroundChanges.empty()) {
-                summary += L"  • Focus changed " + std::to_wstring(foregroundChanges.size()) +
+            if (!focusPauses.empty()) {
+                summary += L"  • Focus changed " + std::to_wstring(focusPauses.size()) +
                            L" time(s) during injection" + nl;
             }
+            for (const FocusPause& pause : focusPauses) {
+                wchar_t pauseStr[160];
+                swprintf_s(pauseStr, L"  • Paused at char %zu for %.0f ms (focus on %s)",
+                    pause.unitsSent, pause.pausedMs, pause.className.c_str());
+                summary += pauseStr + nl;
+            }
             for (const auto& err : errors) {
                 summary += L"  • " + err + nl;
             }
@@ -906,15 +2144,18 @@ struct DiagnosticState {
 };
 
 // Optional keyboard hook for diagnostic verification
-// Counts how many injected events actually reach the system
+// Counts how many injected events actually reach the system, and when the
+// latest one did (adaptive pacing measures submit-to-observe lag from it)
 static HHOOK g_diagHook = nullptr;
 static volatile LONG g_hookEventCount = 0;
+static volatile LONGLONG g_hookLastEventQpc = 0;
 
 LRESULT CALLBACK DiagnosticKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam) {
     if (nCode >= 0) {
         KBDLLHOOKSTRUCT* pKbd = reinterpret_cast<KBDLLHOOKSTRUCT*>(lParam);
         // Count injected events (LLKHF_INJECTED flag)
         if (pKbd->flags & LLKHF_INJECTED) {
+            InterlockedExchange64(&g_hookLastEventQpc, QpcNow());
             InterlockedIncrement(&g_hookEventCount);
         }
     }
@@ -930,89 +2171,1313 @@ bool InstallDiagnosticHook() {
     return (g_diagHook != nullptr);
 }
 
-void RemoveDiagnosticHook() {
-    if (g_diagHook) {
-        UnhookWindowsHookEx(g_diagHook);
-        g_diagHook = nullptr;
+void RemoveDiagnosticHook() {
+    if (g_diagHook) {
+        UnhookWindowsHookEx(g_diagHook);
+        g_diagHook = nullptr;
+    }
+}
+
+size_t GetHookEventCount() {
+    return static_cast<size_t>(InterlockedExchangeAdd(&g_hookEventCount, 0));
+}
+
+void ResetHookEventCount() {
+    InterlockedExchange(&g_hookEventCount, 0);
+}
+
+bool IsDiagnosticHookInstalled() {
+    return (g_diagHook != nullptr);
+}
+
+LONGLONG GetHookLastEventQpc() {
+    return InterlockedCompareExchange64(&g_hookLastEventQpc, 0, 0);
+}
+
+// Low-level keyboard hook for abort detection
+// Intercepts ESC at system level, works even when Citrix/RDP has focus
+// The abort event wakes interruptible pacing waits on the paste worker
+static HHOOK g_abortHook = nullptr;
+static volatile LONG g_abortRequested = 0;
+static volatile LONGLONG g_abortRequestQpc = 0;
+static HANDLE g_abortEvent = nullptr;  // Manual reset, created once and kept for the process
+
+void SignalAbort() {
+    if (InterlockedExchange(&g_abortRequested, 1) == 0) {
+        InterlockedExchange64(&g_abortRequestQpc, QpcNow());
+    }
+    if (g_abortEvent) SetEvent(g_abortEvent);
+}
+
+LRESULT CALLBACK AbortKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam) {
+    if (nCode >= 0 && (wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN)) {
+        KBDLLHOOKSTRUCT* pKbd = reinterpret_cast<KBDLLHOOKSTRUCT*>(lParam);
+        // Check for ESC key (not injected by us)
+        if (pKbd->vkCode == VK_ESCAPE && !(pKbd->flags & LLKHF_INJECTED)) {
+            SignalAbort();
+        }
+    }
+    return CallNextHookEx(g_abortHook, nCode, wParam, lParam);
+}
+
+bool InstallAbortHook() {
+    if (g_abortHook) return true;  // Already installed
+
+    g_abortHook = SetWindowsHookExW(WH_KEYBOARD_LL, AbortKeyboardProc,
+                                     GetModuleHandleW(nullptr), 0);
+    return (g_abortHook != nullptr);
+}
+
+void RemoveAbortHook() {
+    if (g_abortHook) {
+        UnhookWindowsHookEx(g_abortHook);
+        g_abortHook = nullptr;
+    }
+}
+
+bool IsAbortRequested() {
+    return (InterlockedExchangeAdd(&g_abortRequested, 0) != 0);
+}
+
+void ResetAbortFlag() {
+    InterlockedExchange(&g_abortRequested, 0);
+    InterlockedExchange64(&g_abortRequestQpc, 0);
+    if (g_abortEvent) ResetEvent(g_abortEvent);
+}
+
+// Request abort from the UI thread (ARM button clicked while pasting, app exit)
+void RequestAbort() {
+    SignalAbort();
+}
+
+HANDLE GetAbortEvent() {
+    return g_abortEvent;
+}
+
+// Pause hotkey (CTRL+ALT+P) - toggled by the UI thread, honoured by the
+// worker at the next batch boundary
+static volatile LONG g_pauseRequested = 0;
+
+bool TogglePause() {
+    LONG previous = InterlockedCompareExchange(&g_pauseRequested, 0, 0);
+    InterlockedExchange(&g_pauseRequested, previous ? 0 : 1);
+    return previous == 0;
+}
+
+bool IsPauseRequested() {
+    return (InterlockedExchangeAdd(&g_pauseRequested, 0) != 0);
+}
+
+// When the abort was requested (0 = not requested)
+LONGLONG GetAbortRequestQpc() {
+    return InterlockedCompareExchange64(&g_abortRequestQpc, 0, 0);
+}
+
+// Wait up to ms, returning early on abort
+void WaitForAbort(DWORD ms) {
+    if (g_abortEvent) {
+        WaitForSingleObject(g_abortEvent, ms);
+    } else {
+        Sleep(ms);
+    }
+}
+
+// Hook thread
+// The low-level hooks get a thread of their own with nothing else to do, so a
+// busy UI thread (message boxes, painting) never delays ESC, never adds latency
+// to every keystroke on the system, and never trips LowLevelHooksTimeout.
+static HANDLE g_hookThread = nullptr;
+static DWORD g_hookThreadId = 0;
+
+struct HookThreadStart {
+    bool diagnostic;   // Also count injected events (adaptive pacing)
+    bool installed;    // Set by the hook thread: the ESC hook is live
+    HANDLE ready;      // Set once the hooks are installed (or failed to)
+};
+
+DWORD WINAPI HookThreadProc(LPVOID param) {
+    HookThreadStart* start = static_cast<HookThreadStart*>(param);
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+
+    // Create the message queue before anyone can post WM_QUIT to it
+    MSG msg;
+    PeekMessageW(&msg, nullptr, WM_USER, WM_USER, PM_NOREMOVE);
+
+    // Without the ESC hook a paste can't be interrupted; report it and quit
+    bool installed = InstallAbortHook();
+    if (installed && start->diagnostic) InstallDiagnosticHook();
+    start->installed = installed;
+    SetEvent(start->ready);  // start is owned by the caller; don't touch it after this
+    if (!installed) return 1;
+
+    while (GetMessageW(&msg, nullptr, 0, 0) > 0) {
+        TranslateMessage(&msg);
+        DispatchMessageW(&msg);
+    }
+
+    RemoveDiagnosticHook();
+    RemoveAbortHook();
+    return 0;
+}
+
+// Start the hook thread for one paste and wait until its hooks are live
+// Returns false if the thread or the ESC hook could not be started
+bool StartHookThread(bool diagnostic) {
+    if (g_hookThread) return true;  // Already running
+
+    if (!g_abortEvent) g_abortEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    ResetAbortFlag();
+    InterlockedExchange(&g_pauseRequested, 0);
+
+    HookThreadStart start = {};
+    start.diagnostic = diagnostic;
+    start.ready = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (!start.ready) return false;
+
+    g_hookThread = CreateThread(nullptr, 0, HookThreadProc, &start, 0, &g_hookThreadId);
+    if (g_hookThread) WaitForSingleObject(start.ready, INFINITE);
+    CloseHandle(start.ready);
+
+    if (g_hookThread && !start.installed) {
+        WaitForSingleObject(g_hookThread, INFINITE);
+        CloseHandle(g_hookThread);
+        g_hookThread = nullptr;
+        g_hookThreadId = 0;
+    }
+    return (g_hookThread != nullptr);
+}
+
+void StopHookThread() {
+    if (g_hookThread) {
+        PostThreadMessageW(g_hookThreadId, WM_QUIT, 0, 0);
+        WaitForSingleObject(g_hookThread, INFINITE);
+        CloseHandle(g_hookThread);
+        g_hookThread = nullptr;
+        g_hookThreadId = 0;
+    }
+    ResetAbortFlag();
+}
+
+// Foreground tracking via EVENT_SYSTEM_FOREGROUND
+// Out-of-context WinEvents are delivered on the installing (UI) thread, so
+// the state below is only touched there.
+static HWINEVENTHOOK g_foregroundHook = nullptr;
+static HWND g_foregroundHwnd = nullptr;
+static LONGLONG g_foregroundChangeQpc = 0;
+static HWND g_foregroundNotify = nullptr;
+
+void CALLBACK ForegroundEventProc(HWINEVENTHOOK hook, DWORD event, HWND hwnd, LONG idObject,
+                                  LONG idChild, DWORD eventThread, DWORD eventTime) {
+    if (hwnd == g_foregroundHwnd) return;
+    g_foregroundHwnd = hwnd;
+    g_foregroundChangeQpc = QpcNow();
+    if (g_foregroundNotify) PostMessageW(g_foregroundNotify, WM_FOREGROUND_CHANGED, 0, 0);
+}
+
+bool InstallForegroundTracker(HWND notify) {
+    if (g_foregroundHook) return true;  // Already installed
+
+    // Whatever is in front now has been there "forever"
+    g_foregroundHwnd = GetForegroundWindow();
+    g_foregroundChangeQpc = 0;
+    g_foregroundNotify = notify;
+    g_foregroundHook = SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND,
+                                       nullptr, ForegroundEventProc, 0, 0, WINEVENT_OUTOFCONTEXT);
+    return (g_foregroundHook != nullptr);
+}
+
+void RemoveForegroundTracker() {
+    if (g_foregroundHook) {
+        UnhookWinEvent(g_foregroundHook);
+        g_foregroundHook = nullptr;
+    }
+    g_foregroundNotify = nullptr;
+}
+
+// Time the given foreground window has been in front, in ms
+// A window the tracker hasn't seen (hook missing or event still queued) counts as just changed
+double ForegroundStableMs(HWND hwnd) {
+    if (hwnd != g_foregroundHwnd) {
+        g_foregroundHwnd = hwnd;
+        g_foregroundChangeQpc = QpcNow();
+    }
+    return QpcToMs(QpcNow() - g_foregroundChangeQpc);
+}
+
+// Final state of a paste job, published by the worker when it stops
+enum class PasteOutcome : LONG {
+    Running = 0,
+    Completed,
+    Aborted,
+    Failed
+};
+
+// Why the worker is holding (PasteChannel::paused)
+const LONG PAUSED_NONE  = 0;
+const LONG PAUSED_FOCUS = 1;  // Target lost focus
+const LONG PAUSED_USER  = 2;  // Pause hotkey
+
+// Single-producer/single-consumer progress channel between the paste worker
+// and the UI thread. The worker is the only writer and the UI the only reader;
+// each field is one interlocked word, so neither side ever blocks the other.
+struct PasteChannel {
+    volatile LONG charsSent;
+    volatile LONG charsTotal;
+    volatile LONG aborting;  // Worker has seen the abort request and is unwinding
+    volatile LONG paused;    // PAUSED_* - worker is holding at a batch boundary
+    volatile LONG outcome;   // PasteOutcome - written last, after all other results
+};
+
+void PublishProgress(PasteChannel* channel, size_t charsSent) {
+    if (channel) InterlockedExchange(&channel->charsSent, static_cast<LONG>(charsSent));
+}
+
+void PublishOutcome(PasteChannel* channel, PasteOutcome outcome) {
+    if (channel) InterlockedExchange(&channel->outcome, static_cast<LONG>(outcome));
+}
+
+LONG ReadChannel(volatile LONG* field) {
+    return InterlockedExchangeAdd(field, 0);
+}
+
+PasteOutcome ReadOutcome(PasteChannel* channel) {
+    return static_cast<PasteOutcome>(ReadChannel(&channel->outcome));
+}
+
+// Closed-loop per-character delay for PacingStrategy::Adaptive
+// Compares events submitted with injected events the diagnostic hook has seen.
+// While acknowledgements come back quickly the rate grows additively; when the
+// submit-to-observe lag grows, the backlog builds up or events never show up,
+// the rate is halved. At most one back-off per window of outstanding events.
+struct AdaptivePacer {
+    // Submissions not yet acknowledged (ring of cumulative event counts)
+    struct Submission {
+        size_t cumulative;
+        LONGLONG qpc;
+    };
+    static const size_t RING_SIZE = 256;
+    Submission ring[RING_SIZE];
+    size_t ringHead;
+    size_t ringCount;
+
+    bool enabled;             // Hook available - otherwise fixed PER_CHAR_DELAY_MS
+    size_t submitted;         // Events submitted since Start
+    size_t hookBase;          // Hook count corresponding to zero submitted
+    size_t backoffMark;       // No further back-off until acknowledged past this
+    double rateCps;           // Current characters per second
+    double delayMs;           // 1000 / rateCps
+
+    // Statistics
+    double minDelayMs;
+    double maxDelayMs;
+    double lagTotalMs;
+    size_t lagSamples;
+    double lastLagMs;         // Most recent submit-to-observe lag
+    size_t lagSamplesTaken;   // lagSamples when TakeLagSample last returned one
+    size_t increases;
+    size_t backoffs;
+    size_t missingEvents;
+
+    void Start(const PacingConfig& config) {
+        ringHead = 0;
+        ringCount = 0;
+        enabled = IsDiagnosticHookInstalled();
+        submitted = 0;
+        hookBase = GetHookEventCount();
+        backoffMark = 0;
+        SetDelay((std::max)(static_cast<double>(config.perCharDelayMs), ADAPTIVE_MIN_DELAY_MS));
+        minDelayMs = maxDelayMs = delayMs;
+        lagTotalMs = 0.0;
+        lagSamples = 0;
+        lastLagMs = 0.0;
+        lagSamplesTaken = 0;
+        increases = 0;
+        backoffs = 0;
+        missingEvents = 0;
+    }
+
+    void SetDelay(double ms) {
+        delayMs = (std::min)((std::max)(ms, ADAPTIVE_MIN_DELAY_MS), ADAPTIVE_MAX_DELAY_MS);
+        rateCps = 1000.0 / delayMs;
+    }
+
+    void OnSubmitted(UINT events) {
+        if (!enabled || events == 0) return;
+        submitted += events;
+        if (ringCount == RING_SIZE) {
+            // Far behind - forget the oldest submission rather than stall
+            ringHead = (ringHead + 1) % RING_SIZE;
+            ringCount--;
+        }
+        Submission& entry = ring[(ringHead + ringCount) % RING_SIZE];
+        entry.cumulative = submitted;
+        entry.qpc = QpcNow();
+        ringCount++;
+    }
+
+    // Lag sampled since the last call, if any - each sample is handed out once
+    bool TakeLagSample(double& lagMs) {
+        if (lagSamples == lagSamplesTaken) return false;
+        lagSamplesTaken = lagSamples;
+        lagMs = lastLagMs;
+        return true;
+    }
+
+    void Backoff() {
+        SetDelay(1000.0 / (rateCps * ADAPTIVE_BACKOFF));
+        backoffMark = submitted;
+        backoffs++;
+    }
+
+    // Re-evaluate the rate at a character boundary
+    void Update() {
+        if (!enabled) return;
+
+        size_t observed = GetHookEventCount() - hookBase;
+        if (observed > submitted) {
+            // Foreign injected input (or our modifier reset) - rebase
+            hookBase += observed - submitted;
+            observed = submitted;
+        }
+
+        // Retire acknowledged submissions and sample their lag
+        bool acknowledged = false;
+        double lagMs = 0.0;
+        LONGLONG lastSeen = GetHookLastEventQpc();
+        while (ringCount > 0 && ring[ringHead].cumulative <= observed) {
+            lagMs = (std::max)(QpcToMs(lastSeen - ring[ringHead].qpc), 0.0);
+            ringHead = (ringHead + 1) % RING_SIZE;
+            ringCount--;
+            acknowledged = true;
+        }
+        if (acknowledged) {
+            lagTotalMs += lagMs;
+            lagSamples++;
+            lastLagMs = lagMs;
+        }
+
+        bool mayBackoff = (observed >= backoffMark);
+
+        // Oldest submission never observed - treat the gap as lost events
+        if (ringCount > 0 && QpcToMs(QpcNow() - ring[ringHead].qpc) > ADAPTIVE_ACK_TIMEOUT_MS) {
+            size_t lost = ring[ringHead].cumulative - observed;
+            missingEvents += lost;
+            hookBase -= (std::min)(lost, hookBase);
+            ringHead = (ringHead + 1) % RING_SIZE;
+            ringCount--;
+            if (mayBackoff) Backoff();
+        } else if (mayBackoff && ((acknowledged && lagMs > ADAPTIVE_LAG_HIGH_MS) ||
+                                  submitted - observed > ADAPTIVE_MAX_OUTSTANDING)) {
+            Backoff();
+        } else if (acknowledged && lagMs < ADAPTIVE_LAG_LOW_MS &&
+                   submitted - observed <= ADAPTIVE_IDLE_OUTSTANDING) {
+            SetDelay(1000.0 / (rateCps + ADAPTIVE_RATE_STEP_CPS));
+            increases++;
+        }
+
+        minDelayMs = (std::min)(minDelayMs, delayMs);
+        maxDelayMs = (std::max)(maxDelayMs, delayMs);
+    }
+
+    // Line-start guard scales with how far the channel is from the fixed default
+    double LineStartGuardMs(const PacingConfig& config) const {
+        double scale = delayMs / (std::max)(config.perCharDelayMs, 1);
+        return config.lineStartGuardMs * (std::min)(scale, 4.0);
+    }
+
+    void Report(DiagnosticState& diag) const {
+        diag.adaptiveUsed = true;
+        diag.adaptiveFinalDelayMs = delayMs;
+        diag.adaptiveMinDelayMs = minDelayMs;
+        diag.adaptiveMaxDelayMs = maxDelayMs;
+        diag.adaptiveAvgLagMs = lagSamples ? lagTotalMs / lagSamples : 0.0;
+        diag.adaptiveIncreases = increases;
+        diag.adaptiveBackoffs = backoffs;
+        diag.adaptiveMissingEvents = missingEvents;
+        if (!enabled) diag.RecordError(L"Adaptive pacing: hook unavailable, used fixed delay");
+    }
+};
+
+// Token bucket for PacingStrategy::TokenBucket
+// Up to depth events go out back to back; after that submissions wait for
+// tokens refilled at the sustainable rate. Pauses elsewhere (newlines, risky
+// characters) refill the bucket, so the next stretch can burst again.
+struct TokenBucket {
+    double depth;
+    double tokensPerMs;
+    double tokens;
+    LONGLONG lastRefill;
+
+    // Statistics
+    size_t waits;
+    double waitedMs;
+
+    void Start(const PacingConfig& config) {
+        depth = (std::max)(config.bucketDepth, 1);
+        tokensPerMs = (std::max)(config.bucketRatePerSec, 1) / 1000.0;
+        tokens = depth;
+        lastRefill = QpcNow();
+        waits = 0;
+        waitedMs = 0.0;
+    }
+
+    void Refill() {
+        LONGLONG now = QpcNow();
+        tokens = (std::min)(depth, tokens + QpcToMs(now - lastRefill) * tokensPerMs);
+        lastRefill = now;
+    }
+
+    // Block until events tokens are available, then spend them
+    void Acquire(UINT events, PacingScheduler& scheduler) {
+        Refill();
+        if (tokens < events) {
+            double ms = (events - tokens) / tokensPerMs;
+            scheduler.WaitUntil(QpcNow() + MsToQpc(ms));
+            waits++;
+            waitedMs += ms;
+            Refill();
+        }
+        tokens -= events;
+    }
+};
+
+// SendInput batch limit tuner
+// Starts from the size learned for the window class (or the strategy default),
+// halves on partial sends, retries or high hook lag, and after a run of clean
+// full batches probes upwards - doubling until a size has failed, then
+// bisecting towards the smallest size known to fail. A failed size is retried
+// after a longer clean run, so one bad moment doesn't cap the whole paste.
+struct BatchTuner {
+    UINT limit;            // Current max events per SendInput call
+    UINT initialLimit;
+    UINT cap;              // Strategy maximum
+    UINT ceiling;          // Smallest size seen to fail (cap + 1 until one does)
+    bool paced;            // Per-character strategy: batches end at character boundaries
+    size_t cleanFlushes;   // Consecutive full batches without trouble
+    size_t sinceFailure;   // Clean full batches since the ceiling was last lowered or raised
+    size_t fullFlushes;    // Full batches seen (evidence worth persisting)
+    size_t shrinks;
+    size_t grows;
+
+    void Start(const PacingConfig& config) {
+        switch (config.strategy) {
+            case PacingStrategy::Burst:     cap = INPUT_BATCH_SIZE; break;
+            case PacingStrategy::LineBurst: cap = LINE_BURST_MAX_EVENTS; break;
+            case PacingStrategy::TokenBucket:
+                cap = static_cast<UINT>((std::min)((std::max)(config.bucketDepth, 1),
+                                                   LINE_BURST_MAX_EVENTS));
+                break;
+            default:                        cap = BATCH_PACED_MAX_EVENTS; break;
+        }
+
+        // Batched strategies start at their cap, paced ones at one event per call
+        UINT defaultLimit = (config.strategy == PacingStrategy::Burst ||
+                             config.strategy == PacingStrategy::LineBurst ||
+                             config.strategy == PacingStrategy::TokenBucket) ? cap : 1;
+        limit = (config.batchSize > 0) ? static_cast<UINT>(config.batchSize) : defaultLimit;
+        limit = (std::min)((std::max)(limit, 1u), cap);
+        initialLimit = limit;
+        ceiling = cap + 1;
+        paced = (defaultLimit == 1);
+        cleanFlushes = 0;
+        sinceFailure = 0;
+        fullFlushes = 0;
+        shrinks = 0;
+        grows = 0;
+    }
+
+    // paceBoundary: the batch ended at a pacing point rather than at the limit
+    // lagMs: a new hook lag sample (0 if none arrived since the last flush)
+    void OnFlush(UINT offered, bool paceBoundary, bool partial, double lagMs) {
+        if (partial || lagMs > ADAPTIVE_LAG_HIGH_MS) {
+            ceiling = (std::min)(ceiling, (std::max)(offered, 2u));
+            sinceFailure = 0;
+            UINT smaller = (std::max)(limit / 2, 1u);
+            if (smaller < limit) {
+                limit = smaller;
+                shrinks++;
+            }
+            cleanFlushes = 0;
+            return;
+        }
+
+        // Only batches that filled the limit say anything about capacity; paced
+        // strategies send a whole character (2-3 events) per batch, so a batch
+        // ending at its character boundary counts as well
+        if (offered < limit && !(paced && paceBoundary)) return;
+        fullFlushes++;
+        if (ceiling <= cap && ++sinceFailure >= BATCH_CEILING_RELAX_AFTER) {
+            ceiling = (std::min)(ceiling * 2, cap + 1);
+            sinceFailure = 0;
+        }
+        if (++cleanFlushes < BATCH_TUNE_GROW_AFTER) return;
+        cleanFlushes = 0;
+
+        UINT larger = (ceiling > cap) ? limit * 2 : (limit + ceiling) / 2;
+        larger = (std::min)(larger, cap);
+        if (larger > limit) {
+            limit = larger;
+            grows++;
+        }
+    }
+
+    // Worth remembering for the next paste into this window class
+    bool HasLearned() const {
+        return fullFlushes > 0 || shrinks > 0;
+    }
+};
+
+// Delay for a character pace class under the configured rules
+int CharClassDelayMs(const PacingRules& rules, PaceClass pace) {
+    switch (pace) {
+        case PaceClass::CharShiftedSymbol: return rules.shiftedSymbolMs;
+        case PaceClass::CharUnicode:       return rules.unicodeMs;
+        case PaceClass::CharRepeat:        return rules.repeatMs;
+        default:                           return rules.plainMs;
+    }
+}
+
+// Pause after a character boundary op
+// column is the 1-based column of the character just sent
+double CharPauseMs(const KeyOp& op, const PacingConfig& config, const AdaptivePacer* adaptive,
+                   size_t column) {
+    double pauseMs = config.baseKeystrokeDelayMs;
+    int classMs = CharClassDelayMs(config.rules, op.pace);
+    int extraMs = (std::max)(classMs - config.rules.plainMs, 0);
+
+    switch (config.strategy) {
+        case PacingStrategy::Burst:
+            pauseMs += INTER_CHUNK_PAUSE_MS;
+            break;
+        case PacingStrategy::PerCharacter:
+            pauseMs += classMs;
+            break;
+        case PacingStrategy::PerEvent:
+            pauseMs += config.perEventDelayMs + extraMs;
+            break;
+        case PacingStrategy::Adaptive:
+            pauseMs += (adaptive ? adaptive->delayMs : config.perCharDelayMs) + extraMs;
+            break;
+        case PacingStrategy::TokenBucket:
+            pauseMs += extraMs;
+            break;
+        default:
+            break;
+    }
+
+    // Line-start guard: extra delay for first few chars after newline
+    if (op.flags & KOP_LINE_START) {
+        pauseMs += adaptive ? adaptive->LineStartGuardMs(config) : config.lineStartGuardMs;
+    }
+
+    // Line editors redraw the whole line per keystroke - slow down as it grows
+    if (config.columnRampStart > 0 && column > static_cast<size_t>(config.columnRampStart)) {
+        double rampMs = (column - config.columnRampStart) * config.columnRampMsPer100 / 100.0;
+        pauseMs += (std::min)(rampMs, static_cast<double>(COLUMN_RAMP_MAX_MS));
+    }
+    return pauseMs;
+}
+
+// Apply the pause a plan op asks for once its batch has been submitted
+void ApplyPace(const KeyOp& op, size_t column, const PacingConfig& config,
+               PacingScheduler& scheduler, TargetBackpressure* backpressure,
+               AdaptivePacer* adaptive) {
+    int newlinePauseMs = config.baseKeystrokeDelayMs + config.newlinePauseMs / 2;
+
+    switch (op.pace) {
+        case PaceClass::None:
+            break;
+
+        case PaceClass::Event:
+            scheduler.Pause(config.perEventDelayMs);
+            break;
+
+        case PaceClass::Char:
+        case PaceClass::CharShiftedSymbol:
+        case PaceClass::CharUnicode:
+        case PaceClass::CharRepeat:
+            if (adaptive) adaptive->Update();
+            scheduler.Pause(CharPauseMs(op, config, adaptive, column));
+            if (config.strategy == PacingStrategy::Burst) DrainInputQueue(scheduler, backpressure);
+            break;
+
+        case PaceClass::NewlinePre:
+            DrainInputQueue(scheduler, backpressure);
+            scheduler.Pause(newlinePauseMs);
+            break;
+
+        case PaceClass::NewlinePost:
+            scheduler.Pause(newlinePauseMs);
+            DrainInputQueue(scheduler, backpressure);
+            break;
+
+        case PaceClass::NewlineBoth:
+            scheduler.Pause(newlinePauseMs);
+            DrainInputQueue(scheduler, backpressure);
+            scheduler.Pause(newlinePauseMs);
+            break;
+
+        case PaceClass::Line:
+            scheduler.Pause(config.baseKeystrokeDelayMs + LINE_BURST_PAUSE_MS);
+            if (backpressure) backpressure->Wait(scheduler);
+            break;
+    }
+}
+
+// Pacing state for a whole paste. Streamed pastes run one plan per chunk;
+// the batch size, adaptive delay and bucket level carry over between them.
+struct PacingSession {
+    BatchTuner tuner;
+    AdaptivePacer adaptiveState;
+    TokenBucket bucketState;
+    AdaptivePacer* adaptive;   // Adaptive strategy only
+    TokenBucket* bucket;       // Token bucket strategy only
+
+    void Start(const PacingConfig& config) {
+        // Burst submits whole chunks per SendInput, line-burst whole lines; paced
+        // strategies flush at every character. The tuner bounds each call.
+        tuner.Start(config);
+
+        // Adaptive strategy tunes the per-character delay from hook acknowledgements
+        adaptive = nullptr;
+        if (config.strategy == PacingStrategy::Adaptive) {
+            adaptive = &adaptiveState;
+            adaptive->Start(config);
+        }
+
+        // Token bucket spaces batches at the sustainable rate
+        bucket = nullptr;
+        if (config.strategy == PacingStrategy::TokenBucket) {
+            bucket = &bucketState;
+            bucket->Start(config);
+        }
+    }
+
+    void Report(DiagnosticState& diag, const PacingConfig& config) {
+        if (adaptive) adaptive->Report(diag);
+        if (bucket) {
+            diag.bucketUsed = true;
+            diag.bucketDepth = config.bucketDepth;
+            diag.bucketRatePerSec = config.bucketRatePerSec;
+            diag.bucketWaits = bucket->waits;
+            diag.bucketWaitedMs = bucket->waitedMs;
+        }
+        diag.batchInitialLimit = tuner.initialLimit;
+        diag.batchFinalLimit = tuner.limit;
+        diag.batchCap = tuner.cap;
+        diag.batchShrinks = tuner.shrinks;
+        diag.batchGrows = tuner.grows;
+        diag.batchLearned = tuner.HasLearned();
+    }
+};
+
+// Cursor for a source offset in a compiled plan (see SeekOps)
+// Plans are rebuilt between pastes, so interrupted pastes resume by units, not ops
+InjectionCursor SeekPlan(const KeystrokePlan& plan, size_t units) {
+    return SeekOps(plan.ops.data(), plan.ops.size(), plan.startColumn, units);
+}
+
+// Press a Shift that was held when injection stopped at a boundary
+void PressHeldShift(WORD heldShift) {
+    if (!heldShift) return;
+    INPUT input = {};
+    input.type = INPUT_KEYBOARD;
+    input.ki.wScan = heldShift;
+    input.ki.dwFlags = KEYEVENTF_SCANCODE;
+    SendInput(1, &input, sizeof(INPUT));
+}
+
+// Let go of that Shift again. Only Shift: an injected Ctrl/Alt key-up would
+// also clear the async state of a chord the user is still holding.
+void ReleaseInjectedShift(WORD heldShift) {
+    if (!heldShift) return;
+    INPUT input = {};
+    input.type = INPUT_KEYBOARD;
+    input.ki.wScan = heldShift;
+    input.ki.dwFlags = KEYEVENTF_SCANCODE | KEYEVENTF_KEYUP;
+    SendInput(1, &input, sizeof(INPUT));
+}
+
+// Wait until the user has let go of Ctrl and Alt, then release all modifiers
+// The pause hotkey is a Ctrl+Alt chord; keys injected while it is still held
+// arrive as shortcuts, or as AltGr characters on European layouts.
+// Returns false if the paste was aborted while waiting.
+bool WaitForChordRelease() {
+    while ((GetAsyncKeyState(VK_CONTROL) & 0x8000) || (GetAsyncKeyState(VK_MENU) & 0x8000)) {
+        if (IsAbortRequested()) return false;
+        WaitForAbort(FOCUS_PAUSE_POLL_MS);
+    }
+    ResetModifiers();
+    return true;
+}
+
+// Hold at a batch boundary while the pause hotkey is active
+PasteOutcome WaitWhilePaused(WORD heldShift, DiagnosticState* diag, PasteChannel* channel) {
+    LONGLONG pauseStart = QpcNow();
+    if (channel) InterlockedExchange(&channel->paused, PAUSED_USER);
+
+    // Shift first: with the user's Ctrl+Alt down, a held Shift makes Alt+Shift
+    // or Ctrl+Shift, which switch the keyboard layout
+    ReleaseInjectedShift(heldShift);
+    PasteOutcome result = WaitForChordRelease() ? PasteOutcome::Running : PasteOutcome::Aborted;
+    while (result == PasteOutcome::Running && IsPauseRequested()) {
+        if (IsAbortRequested()) {
+            result = PasteOutcome::Aborted;
+            break;
+        }
+        WaitForAbort(FOCUS_PAUSE_POLL_MS);
+    }
+
+    // The resume press is the same chord; it must be released before typing again
+    if (result == PasteOutcome::Running && !WaitForChordRelease()) result = PasteOutcome::Aborted;
+    if (result == PasteOutcome::Running) PressHeldShift(heldShift);
+    if (channel) InterlockedExchange(&channel->paused, PAUSED_NONE);
+    if (diag) {
+        diag->userPauses++;
+        diag->userPausedMs += QpcToMs(QpcNow() - pauseStart);
+    }
+    return result;
+}
+
+// Pause while the target window is not in the foreground
+// A held Shift is released so it can't leak into the other window, and pressed
+// again before resuming. Returns Running once the target has been back in front
+// for FOCUS_RESUME_SETTLE_MS.
+PasteOutcome WaitForTargetFocus(HWND target, WORD heldShift, DiagnosticState* diag,
+                                PasteChannel* channel, size_t unitsSent) {
+    LONGLONG pauseStart = QpcNow();
+    HWND foreground = GetForegroundWindow();
+    ResetModifiers();
+    if (channel) InterlockedExchange(&channel->paused, PAUSED_FOCUS);
+
+    PasteOutcome result = PasteOutcome::Running;
+    LONGLONG backSince = 0;  // Target in front since (0 = not in front)
+    for (;;) {
+        if (IsAbortRequested()) {
+            result = PasteOutcome::Aborted;
+            break;
+        }
+        if (!IsWindow(target)) {
+            if (diag) diag->RecordError(L"Target window closed while paused");
+            result = PasteOutcome::Failed;
+            break;
+        }
+        if (GetForegroundWindow() == target) {
+            if (backSince == 0) backSince = QpcNow();
+            if (QpcToMs(QpcNow() - backSince) >= FOCUS_RESUME_SETTLE_MS) break;
+        } else {
+            backSince = 0;
+        }
+        WaitForAbort(FOCUS_PAUSE_POLL_MS);
+    }
+
+    if (result == PasteOutcome::Running) PressHeldShift(heldShift);
+
+    if (channel) InterlockedExchange(&channel->paused, PAUSED_NONE);
+    if (diag) diag->RecordFocusPause(foreground, unitsSent, QpcToMs(QpcNow() - pauseStart));
+    return result;
+}
+
+// Execute a compiled plan: expand ops into fixed-size INPUT batches and pace them
+// No mapping work or allocation happens here. cursor.units counts source text
+// units (a CRLF pair counts as two) whose events were all delivered.
+// Runs from cursor until the plan completes, fails or is aborted; cursor is
+// left on the first op not sent. Pauses (hotkey, focus loss) hold the worker
+// at a batch boundary and continue from the same cursor.
+// targetHwnd (optional) enables the focus-loss guard: injection pauses at the
+// next batch boundary while another window is in front.
+// unitsBase is the stream offset of the plan's first unit (progress reporting).
+PasteOutcome ExecuteKeystrokePlan(const KeystrokePlan& plan, const PacingConfig& config,
+                                  PacingScheduler& scheduler, TargetBackpressure* backpressure,
+                                  PacingSession& session, DiagnosticState* diag,
+                                  PasteChannel* channel, HWND targetHwnd, size_t unitsBase,
+                                  InjectionCursor& cursor) {
+    INPUT batch[LINE_BURST_MAX_EVENTS] = {};
+    UINT batchCount = 0;
+    size_t pendingUnits = 0;  // Units completed by ops in the current batch
+    size_t pendingLineStart = cursor.lineStart;
+
+    BatchTuner& tuner = session.tuner;
+    AdaptivePacer* adaptive = session.adaptive;
+    TokenBucket* bucket = session.bucket;
+
+    size_t unitsSent = cursor.units;
+    size_t column = cursor.column;
+    WORD heldShift = cursor.heldShift;
+    PasteOutcome outcome = PasteOutcome::Completed;
+
+    // Resuming inside a run of shifted characters
+    PressHeldShift(heldShift);
+    PublishProgress(channel, unitsBase + unitsSent);
+
+    for (size_t i = cursor.op; i < plan.ops.size(); i++) {
+        // Pause hotkey at batch boundaries
+        if (batchCount == 0 && IsPauseRequested()) {
+            PasteOutcome resumed = WaitWhilePaused(heldShift, diag, channel);
+            if (resumed != PasteOutcome::Running) {
+                if (channel) InterlockedExchange(&channel->aborting, 1);
+                outcome = resumed;
+                break;
+            }
+        }
+
+        // Focus guard at batch boundaries - never split a batch between two windows
+        if (batchCount == 0 && targetHwnd && GetForegroundWindow() != targetHwnd) {
+            PasteOutcome resumed = WaitForTargetFocus(targetHwnd, heldShift, diag, channel,
+                                                      unitsBase + unitsSent);
+            if (resumed != PasteOutcome::Running) {
+                outcome = resumed;
+                if (outcome == PasteOutcome::Aborted && channel) {
+                    InterlockedExchange(&channel->aborting, 1);
+                }
+                break;
+            }
+        }
+
+        // Check for ESC at batch boundaries
+        if (batchCount == 0 && IsAbortRequested()) {
+            if (channel) InterlockedExchange(&channel->aborting, 1);
+            outcome = PasteOutcome::Aborted;
+            break;
+        }
+
+        const KeyOp& op = plan.ops[i];
+        ExpandKeyOp(op, batch[batchCount++]);
+        if (op.flags & KOP_SHIFT) heldShift = (op.flags & KOP_KEYUP) ? 0 : op.code;
+        if (op.flags & KOP_CHAR_END) {
+            pendingUnits += CharEndUnits(op);
+            column++;
+        }
+        if (op.flags & KOP_LINE_END) {
+            column = 0;
+            if (op.flags & KOP_CHAR_END) pendingLineStart = unitsSent + pendingUnits;
+        }
+
+        bool lastOp = (i + 1 == plan.ops.size());
+        if (op.pace == PaceClass::None && batchCount < tuner.limit && !lastOp) {
+            continue;
+        }
+
+        if (bucket) {
+            bucket->Acquire(batchCount, scheduler);
+            if (IsAbortRequested()) {
+                // The bucket wait was cut short; drop the unsent batch
+                if (channel) InterlockedExchange(&channel->aborting, 1);
+                outcome = PasteOutcome::Aborted;
+                break;
+            }
+        }
+
+        if (diag) {
+            if (diag->firstEventQpc == 0) diag->firstEventQpc = QpcNow();
+            diag->totalEventsAttempted += batchCount;
+        }
+        bool partial = false;
+        if (!FlushInputs(batch, batchCount, diag ? &diag->totalEventsSent : nullptr, &partial)) {
+            if (diag) diag->RecordError(L"FlushInputs failed");
+            outcome = PasteOutcome::Failed;
+            break;
+        }
+        if (adaptive) adaptive->OnSubmitted(batchCount);
+        if (backpressure) backpressure->OnSubmitted(batchCount);
+        double lagMs = 0.0;
+        if (adaptive) adaptive->TakeLagSample(lagMs);
+        tuner.OnFlush(batchCount, op.pace != PaceClass::None, partial, lagMs);
+        batchCount = 0;
+
+        if (pendingUnits > 0) {
+            unitsSent += pendingUnits;
+            pendingUnits = 0;
+            PublishProgress(channel, unitsBase + unitsSent);
+        }
+
+        cursor.op = i + 1;
+        cursor.units = unitsSent;
+        cursor.column = column;
+        cursor.lineStart = pendingLineStart;
+        cursor.heldShift = heldShift;
+
+        ApplyPace(op, column, config, scheduler, backpressure, adaptive);
+    }
+
+    return outcome;
+}
+
+inline int ClampInt(int value, int low, int high) {
+    return (value < low) ? low : (value > high) ? high : value;
+}
+
+// Fold a finished paste into the target's profile
+// Drops or congestion slow the profile down at once; speed-ups need a streak of clean pastes
+void UpdateTargetProfile(TargetProfile& profile, const DiagnosticState& diag, PasteOutcome outcome) {
+    if (diag.batchLearned) profile.batchSize = static_cast<int>(diag.batchFinalLimit);
+
+    // A cancelled paste says nothing about whether the pacing was right
+    if (outcome == PasteOutcome::Aborted) return;
+    profile.pastes++;
+
+    bool troubled = (outcome != PasteOutcome::Completed) ||
+                    diag.totalEventsSent < diag.totalEventsAttempted ||
+                    diag.adaptiveMissingEvents > 0 ||
+                    diag.batchShrinks > 0 ||
+                    (diag.adaptiveUsed && diag.adaptiveAvgLagMs > PROFILE_LAG_HIGH_MS);
+
+    if (troubled) {
+        profile.perCharDelayMs = ClampInt(profile.perCharDelayMs * 3 / 2 + 1,
+                                          PROFILE_MIN_CHAR_MS, PROFILE_MAX_CHAR_MS);
+        profile.lineStartGuardMs = ClampInt(profile.lineStartGuardMs * 3 / 2 + 1, 0, PROFILE_MAX_GUARD_MS);
+        profile.newlinePauseMs = ClampInt(profile.newlinePauseMs * 5 / 4 + 10,
+                                          PROFILE_MIN_NEWLINE_MS, PROFILE_MAX_NEWLINE_MS);
+        profile.perEventDelayMs = ClampInt(profile.perEventDelayMs + 1, 0, PROFILE_MAX_EVENT_MS);
+        profile.bucketRatePerSec = ClampInt(profile.bucketRatePerSec * 2 / 3,
+                                            PROFILE_MIN_BUCKET_RATE, PROFILE_MAX_BUCKET_RATE);
+        profile.cleanStreak = 0;
+        return;
+    }
+
+    // Adaptive pacing already found a working rate; start the next paste there
+    if (diag.adaptiveUsed) {
+        profile.perCharDelayMs = ClampInt(static_cast<int>(diag.adaptiveFinalDelayMs + 0.5),
+                                          PROFILE_MIN_CHAR_MS, PROFILE_MAX_CHAR_MS);
+    }
+
+    if (++profile.cleanStreak < PROFILE_SPEEDUP_STREAK) return;
+    profile.cleanStreak = 0;
+    profile.perCharDelayMs = ClampInt(profile.perCharDelayMs * 4 / 5, PROFILE_MIN_CHAR_MS, PROFILE_MAX_CHAR_MS);
+    profile.lineStartGuardMs = ClampInt(profile.lineStartGuardMs * 4 / 5, 0, PROFILE_MAX_GUARD_MS);
+    profile.newlinePauseMs = ClampInt(profile.newlinePauseMs * 9 / 10,
+                                      PROFILE_MIN_NEWLINE_MS, PROFILE_MAX_NEWLINE_MS);
+    profile.perEventDelayMs = ClampInt(profile.perEventDelayMs * 4 / 5, 0, PROFILE_MAX_EVENT_MS);
+    profile.bucketRatePerSec = ClampInt(profile.bucketRatePerSec * 5 / 4,
+                                        PROFILE_MIN_BUCKET_RATE, PROFILE_MAX_BUCKET_RATE);
+}
+
+} // namespace inject
+
+// ============================================================================
+// Keyboard Simulation
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// Streaming paste pipeline
+//
+// A reader thread decodes and normalizes the source block by block into a
+// bounded ring; the paste worker takes line-aligned chunks from the ring and
+// plans and injects one chunk at a time. Memory use does not grow with the
+// payload, and the first keystroke goes out once the first chunk is read.
+//
+// Stages pass std::wstring_view blocks to the next stage and return false to
+// stop the source. None of them copies the whole text: clipboard blocks are
+// views of the copied clipboard text, file blocks are one decoded view, and
+// normalization copies a block only when it replaces something. Text is
+// copied into the ring and from the ring into the chunk buffer, both bounded,
+// and the planner compiles the chunk in place.
+// ----------------------------------------------------------------------------
+
+const size_t STREAM_RING_UNITS = 64 * 1024;        // Ring capacity (UTF-16 units)
+const size_t STREAM_TEXT_BLOCK = 16 * 1024;        // Clipboard text is normalized in blocks this size
+
+// Where a paste's text comes from
+struct PasteSource {
+    bool fromFile;
+    std::wstring filePath;
+    std::wstring text;       // Clipboard text as copied (normalized while streaming)
+    size_t estimatedUnits;   // Expected length before the text has been read (progress)
+
+    PasteSource() : fromFile(false), estimatedUnits(0) {}
+};
+
+// Source stage: hands the source's text to onBlock block by block, as views
+// Returns false with error set if the source can't be read
+template <typename BlockFn>
+bool ReadSourceBlocks(const PasteSource& source, BlockFn onBlock, std::wstring& error) {
+    if (source.fromFile) return readFileBlocks(source.filePath, onBlock, error);
+
+    std::wstring_view text(source.text);
+    for (size_t offset = 0; offset < text.size(); offset += STREAM_TEXT_BLOCK) {
+        if (!onBlock(text.substr(offset, STREAM_TEXT_BLOCK))) break;
+    }
+    return true;
+}
+
+// Normalization stage: smart characters replaced (NormalizeSmartCharacters)
+template <typename Next>
+struct NormalizeStage {
+    Next next;
+    std::wstring scratch;  // Reused for every block that needs replacing
+
+    explicit NormalizeStage(Next nextStage) : next(nextStage) {}
+
+    bool operator()(std::wstring_view block) {
+        return next(textnormalize::NormalizeSmartCharacters(block, scratch));
     }
+};
+
+template <typename Next>
+NormalizeStage<Next> Normalized(Next next) {
+    return NormalizeStage<Next>(next);
 }
 
-size_t GetHookEventCount() {
-    return static_cast<size_t>(InterlockedExchangeAdd(&g_hookEventCount, 0));
+// A source's normalized text, block by block - what gets hashed and typed
+template <typename BlockFn>
+bool ReadNormalizedBlocks(const PasteSource& source, BlockFn onBlock, std::wstring& error) {
+    return ReadSourceBlocks(source, Normalized(onBlock), error);
 }
 
-void ResetHookEventCount() {
-    InterlockedExchange(&g_hookEventCount, 0);
+// Hash the first units of a source's normalized text (resume matching)
+// Reads only as far as it has to; false if the source is shorter or unreadable
+bool HashSourcePrefix(const PasteSource& source, size_t units, ULONGLONG& hash) {
+    hash = inject::TEXT_HASH_SEED;
+    size_t length = 0;
+    std::wstring error;
+    bool success = ReadNormalizedBlocks(source, [&](std::wstring_view block) {
+        size_t take = (std::min)(block.size(), units - length);
+        hash = inject::HashText(block.data(), take, hash);
+        length += take;
+        return length < units;
+    }, error);
+    return success && length == units;
 }
 
-// Low-level keyboard hook for abort detection
-// Intercepts ESC at system level, works even when Citrix/RDP has focus
-static HHOOK g_abortHook = nullptr;
-static volatile LONG g_abortRequested = 0;
+// Bounded single-producer/single-consumer ring of UTF-16 units
+struct TextRing {
+    std::vector<wchar_t> buffer;
+    size_t readPos;
+    size_t count;
+    bool finished;            // Producer has written everything
+    bool closed;              // Consumer has stopped reading
+    SRWLOCK lock;
+    CONDITION_VARIABLE dataReady;
+    CONDITION_VARIABLE spaceReady;
+
+    TextRing() : buffer(STREAM_RING_UNITS), readPos(0), count(0), finished(false), closed(false) {
+        InitializeSRWLock(&lock);
+        InitializeConditionVariable(&dataReady);
+        InitializeConditionVariable(&spaceReady);
+    }
 
-LRESULT CALLBACK AbortKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam) {
-    if (nCode >= 0 && (wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN)) {
-        KBDLLHOOKSTRUCT* pKbd = reinterpret_cast<KBDLLHOOKSTRUCT*>(lParam);
-        // Check for ESC key (not injected by us)
-        if (pKbd->vkCode == VK_ESCAPE && !(pKbd->flags & LLKHF_INJECTED)) {
-            InterlockedExchange(&g_abortRequested, 1);
+    // Producer: blocks while the ring is full
+    // Returns false once the consumer has closed the ring
+    bool Write(const wchar_t* data, size_t length) {
+        AcquireSRWLockExclusive(&lock);
+        while (length > 0 && !closed) {
+            if (count == buffer.size()) {
+                SleepConditionVariableSRW(&spaceReady, &lock, INFINITE, 0);
+                continue;
+            }
+            size_t writePos = (readPos + count) % buffer.size();
+            size_t n = (std::min)(length, (std::min)(buffer.size() - count, buffer.size() - writePos));
+            std::copy(data, data + n, buffer.begin() + writePos);
+            count += n;
+            data += n;
+            length -= n;
+            WakeConditionVariable(&dataReady);
         }
+        bool open = !closed;
+        ReleaseSRWLockExclusive(&lock);
+        return open;
     }
-    return CallNextHookEx(g_abortHook, nCode, wParam, lParam);
-}
 
-bool InstallAbortHook() {
-    if (g_abortHook) return true;  // Already installed
+    void Finish() {
+        AcquireSRWLockExclusive(&lock);
+        finished = true;
+        ReleaseSRWLockExclusive(&lock);
+        WakeConditionVariable(&dataReady);
+    }
 
-    g_abortRequested = 0;
-    g_abortHook = SetWindowsHookExW(WH_KEYBOARD_LL, AbortKeyboardProc,
-                                     GetModuleHandleW(nullptr), 0);
-    return (g_abortHook != nullptr);
-}
+    // Consumer: blocks until data is available, then appends it to out
+    // Returns the units appended; 0 means the producer has finished
+    size_t Read(std::wstring& out, size_t maxUnits) {
+        AcquireSRWLockExclusive(&lock);
+        while (count == 0 && !finished) {
+            SleepConditionVariableSRW(&dataReady, &lock, INFINITE, 0);
+        }
+        size_t n = (std::min)(maxUnits, (std::min)(count, buffer.size() - readPos));
+        out.append(buffer.data() + readPos, n);
+        readPos = (readPos + n) % buffer.size();
+        count -= n;
+        ReleaseSRWLockExclusive(&lock);
+        WakeConditionVariable(&spaceReady);
+        return n;
+    }
 
-void RemoveAbortHook() {
-    if (g_abortHook) {
-        UnhookWindowsHookEx(g_abortHook);
-        g_abortHook = nullptr;
+    // Consumer: stop reading; a blocked producer returns at once
+    void Close() {
+        AcquireSRWLockExclusive(&lock);
+        closed = true;
+        ReleaseSRWLockExclusive(&lock);
+        WakeConditionVariable(&spaceReady);
+    }
+};
+
+// One paste's reader thread and the ring it fills
+// The reader stops the source as soon as the consumer closes the ring or ESC
+// is pressed; the hash and length are then never finished. Resuming doesn't
+// need them - the worker hashes the text it typed (TypedHashes).
+struct TextStream {
+    PasteSource source;
+    TextRing ring;
+    inject::PasteChannel* channel;  // Gets the exact total once the source is read
+    HANDLE hThread;
+
+    // Resumed pastes: the text before verifyUnits must still hash to verifyHash
+    // (what the resume prompt checked), or nothing past it is written
+    size_t verifyUnits;
+    ULONGLONG verifyHash;
+
+    // Results, valid once the reader has finished
+    bool stopped;            // Stopped early (abort, consumer gone); hash and length not set
+    ULONGLONG textHash;      // Same as HashText over the whole normalized text
+    size_t totalUnits;
+    bool failed;
+    bool changed;            // Source no longer matches the resume prompt (also failed)
+    std::wstring error;
+
+    TextStream() : channel(nullptr), hThread(nullptr), verifyUnits(0), verifyHash(0),
+                   stopped(false), textHash(0), totalUnits(0), failed(false), changed(false) {}
+};
+
+DWORD WINAPI StreamReaderProc(LPVOID param) {
+    TextStream* stream = static_cast<TextStream*>(param);
+
+    ULONGLONG hash = inject::TEXT_HASH_SEED;
+    size_t total = 0;
+    bool verifying = (stream->verifyUnits > 0);
+    bool success = ReadNormalizedBlocks(stream->source, [&](std::wstring_view block) {
+        if (inject::IsAbortRequested()) {
+            stream->stopped = true;
+            return false;
+        }
+        if (verifying && total + block.size() >= stream->verifyUnits) {
+            // Edited since the prompt: end the stream before anything past the offset
+            verifying = false;
+            if (inject::HashText(block.data(), stream->verifyUnits - total, hash) != stream->verifyHash) {
+                stream->changed = true;
+                return false;
+            }
+        }
+        hash = inject::HashText(block.data(), block.size(), hash);
+        total += block.size();
+        if (!stream->ring.Write(block.data(), block.size())) {
+            stream->stopped = true;  // The worker has stopped reading
+            return false;
+        }
+        return true;
+    }, stream->error);
+
+    if (verifying && !stream->stopped) stream->changed = true;  // Now shorter than the resume offset
+    if (stream->changed) stream->error = L"Source changed since the resume prompt";
+
+    if (!stream->stopped) {
+        stream->textHash = hash;
+        stream->totalUnits = total;
+        if (stream->channel) InterlockedExchange(&stream->channel->charsTotal, static_cast<LONG>(total));
     }
-    g_abortRequested = 0;
+    stream->failed = !success || stream->changed;
+    stream->ring.Finish();
+    return 0;
 }
 
-bool IsAbortRequested() {
-    return (InterlockedExchangeAdd(&g_abortRequested, 0) != 0);
+bool StartTextStream(TextStream& stream) {
+    stream.hThread = CreateThread(nullptr, 0, StreamReaderProc, &stream, 0, nullptr);
+    return (stream.hThread != nullptr);
 }
 
-void ResetAbortFlag() {
-    InterlockedExchange(&g_abortRequested, 0);
+// Stop consuming and wait for the reader, which quits at its next block
+void StopTextStream(TextStream& stream) {
+    stream.ring.Close();
+    if (!stream.hThread) return;
+    WaitForSingleObject(stream.hThread, INFINITE);
+    CloseHandle(stream.hThread);
+    stream.hThread = nullptr;
 }
 
-} // namespace inject
+// Chunk buffer the ring is read into; chunks are views of its front
+struct ChunkBuffer {
+    std::wstring pending;  // Read from the ring, not yet typed
+    size_t chunkUnits;     // Front of pending handed out as the current chunk
 
-// ============================================================================
-// Keyboard Simulation
-// ============================================================================
+    ChunkBuffer() : chunkUnits(0) {}
+};
+
+// Take the next line-aligned chunk from the stream; returns false at the end
+// The chunk is valid until the next call, which drops it and keeps only the
+// units read past its cut (at most a partial line)
+bool ReadStreamChunk(TextStream& stream, ChunkBuffer& buffer, std::wstring_view& chunk) {
+    buffer.pending.erase(0, buffer.chunkUnits);
+    buffer.chunkUnits = 0;
+
+    bool ended = false;
+    for (;;) {
+        size_t cut = inject::FindChunkCut(buffer.pending.data(), buffer.pending.size(), ended);
+        if (cut > 0) {
+            buffer.chunkUnits = cut;
+            chunk = std::wstring_view(buffer.pending.data(), cut);
+            return true;
+        }
+        if (ended) return false;
+
+        if (stream.ring.Read(buffer.pending, inject::STREAM_CHUNK_UNITS) == 0) ended = true;
+    }
+}
+
+// Where a paste stopped, with the hash of the text before each offset
+// Resume matching compares prefixes, so it never needs the rest of the source
+struct StopPoint {
+    size_t lineOffset;       // Start of the last line not fully sent
+    ULONGLONG sentHash;      // Text before the returned character count
+    ULONGLONG lineHash;      // Text before lineOffset
+};
+
+// Hashes of the text typed so far, for the StopPoint
+// Whole chunks are hashed once; a partial hash is only needed where the paste
+// stopped or where a line runs on into the next chunk
+struct TypedHashes {
+    ULONGLONG text;   // Text before the next chunk
+    ULONGLONG sent;   // Text before charsSent
+    ULONGLONG line;   // Text before lineStart
+
+    TypedHashes() : text(inject::TEXT_HASH_SEED), sent(text), line(text) {}
+
+    void Advance(std::wstring_view chunk, size_t chunkStart, size_t charsSent, size_t lineStart) {
+        ULONGLONG chunkHash = inject::HashText(chunk.data(), chunk.size(), text);
+        size_t chunkEnd = chunkStart + chunk.size();
+        sent = (charsSent == chunkEnd) ? chunkHash
+             : inject::HashText(chunk.data(), charsSent - chunkStart, text);
+        if (lineStart == chunkEnd) {
+            line = chunkHash;
+        } else if (lineStart >= chunkStart) {
+            line = inject::HashText(chunk.data(), lineStart - chunkStart, text);
+        }
+        text = chunkHash;
+    }
+};
 
-// Progress callback type for injection progress reporting
-typedef void (*ProgressCallback)(size_t current, size_t total);
+// Plan cache - only the paste worker touches it, and only one worker runs at a time
+static inject::KeystrokePlan g_keystrokePlan = {};
 
 // Extended injection function with mode and pacing configuration
-size_t sendTextToWindowEx(const std::wstring& text, InjectionMode mode,
+// Runs on the paste worker thread; progress and the final outcome are
+// published through the channel, never by messaging the UI thread.
+// Starts the stream's reader and plans and injects the text chunk by chunk
+// as it arrives. clientInfo is the target detected when the job was prepared;
+// startUnits continues an interrupted paste of the same text from that offset.
+// stop (optional) gets the start of the last line not fully sent and the
+// hashes of the text before it and before the returned count.
+size_t sendStreamToWindow(TextStream& stream, InjectionMode mode,
                           const inject::PacingConfig& config,
+                          const inject::RemoteClientInfo& clientInfo,
                           inject::DiagnosticState* diag,
-                          ProgressCallback progressCallback = nullptr) {
-    // Enable high-resolution timer for precise Sleep() calls
-    inject::TimerResolutionGuard timerGuard;
-
-    // Install low-level keyboard hook for ESC detection (works even in Citrix/RDP)
-    inject::InstallAbortHook();
-
+                          inject::PasteChannel* channel = nullptr,
+                          size_t startUnits = 0,
+                          StopPoint* stop = nullptr,
+                          bool fromHotkey = false) {
     if (diag) {
         diag->startTime = GetTickCount();
     }
 
-    // Detect remote client for keyboard layout
-    inject::RemoteClientInfo clientInfo = inject::DetectRemoteClient();
     HKL layout = clientInfo.keyboardLayout;
+    TargetClass target = clientInfo.targetClass;
 
     // Resolve Auto mode - default to Hybrid for best compatibility with remote sessions
     InjectionMode resolvedMode = mode;
@@ -1023,164 +3488,132 @@ size_t sendTextToWindowEx(const std::wstring& text, InjectionMode mode,
     // Reset modifiers at start (clean slate)
     inject::ResetModifiers();
 
-    std::vector<INPUT> buffer;
-    buffer.reserve(16);  // Larger for VK mode with shift events
+    // Deadlines start counting from the first event; ESC cuts any wait short
+    inject::PacingScheduler scheduler;
+    scheduler.interrupt = inject::GetAbortEvent();
 
-    size_t charsSent = 0;
-    size_t charsInBuffer = 0;
-    size_t charsSinceNewline = 0;  // For line-start guard
+    // Local targets: drain only while the target still has input queued
+    bool localTarget = (target == TargetClass::Local);
+    inject::TargetBackpressure backpressureState(localTarget ? clientInfo.hwnd : nullptr);
+    inject::TargetBackpressure* backpressure = localTarget ? &backpressureState : nullptr;
 
-    for (size_t i = 0; i < text.size(); ++i) {
-        // Check for ESC at chunk boundaries (using low-level hook for Citrix/RDP compatibility)
-        if (buffer.empty() && inject::IsAbortRequested()) {
-            inject::ResetModifiers();
-            inject::RemoveAbortHook();
-            if (diag) {
-                diag->endTime = GetTickCount();
-                diag->totalCharsSent = charsSent;
-                diag->RecordError(L"User cancelled with ESC");
-            }
-            return charsSent;
-        }
+    inject::PacingSession session;
+    session.Start(config);
 
-        wchar_t c = text[i];
+    inject::PasteOutcome outcome = inject::PasteOutcome::Completed;
+    stream.channel = channel;
+    if (!StartTextStream(stream)) {
+        if (diag) diag->RecordError(L"Failed to start text reader");
+        outcome = inject::PasteOutcome::Failed;
+    }
 
-        // Skip '\r' in CRLF sequences
-        if (c == L'\r' && i + 1 < text.size() && text[i + 1] == L'\n') {
-            continue;
-        }
+    // Ctrl+Alt from the paste hotkey may still be held; keys sent now would
+    // arrive as shortcuts (or AltGr characters). The reader fills the ring meanwhile.
+    if (fromHotkey && outcome == inject::PasteOutcome::Completed) {
+        LONGLONG chordStart = inject::QpcNow();
+        if (!inject::WaitForChordRelease()) outcome = inject::PasteOutcome::Aborted;
+        if (diag) diag->chordWaitMs = inject::QpcToMs(inject::QpcNow() - chordStart);
+    }
 
-        // Handle newlines
-        if (c == L'\n' || c == L'\r') {
-            // Flush any pending characters
-            if (!buffer.empty()) {
-                if (diag) diag->totalEventsAttempted += buffer.size();
-
-                if (config.strategy == PacingStrategy::Burst) {
-                    if (!inject::FlushInputs(buffer, diag ? &diag->totalEventsSent : nullptr)) {
-                        inject::ResetModifiers();
-                        inject::RemoveAbortHook();
-                        if (diag) {
-                            diag->endTime = GetTickCount();
-                            diag->totalCharsSent = charsSent;
-                            diag->RecordError(L"FlushInputs failed before newline");
-                        }
-                        return charsSent;
-                    }
-                } else {
-                    size_t sent = inject::FlushInputsWithPacing(buffer, config, diag);
-                    if (diag) diag->totalEventsSent += sent;
-                }
-                charsSent += charsInBuffer;
-                charsInBuffer = 0;
-                if (progressCallback) progressCallback(charsSent, text.size());
+    inject::KeystrokePlan& plan = g_keystrokePlan;
+    ChunkBuffer chunkBuffer;
+    std::wstring_view chunk;
+    size_t chunkStart = 0;   // Stream offset of the current chunk
+    size_t charsSent = 0;
+    size_t lineStart = 0;
+    size_t column = 0;       // Column the chunk starts at (previous chunk cut mid-line)
+    TypedHashes typed;
+
+    while (outcome == inject::PasteOutcome::Completed && ReadStreamChunk(stream, chunkBuffer, chunk)) {
+        size_t chunkEnd = chunkStart + chunk.size();
+        bool midLine = (lineStart < chunkStart);  // Chunk continues a line cut mid-way
+        wchar_t last = chunk.back();
+        bool endsLine = (last == L'\r' || last == L'\n');
+
+        if (chunkEnd <= startUnits) {
+            // Already typed by the interrupted paste; a line cut mid-way is
+            // planned anyway, for the column the next chunk starts at
+            size_t lineBreak = chunk.find_last_of(L"\r\n");
+            if (lineBreak != std::wstring_view::npos) lineStart = chunkStart + lineBreak + 1;
+            if (!endsLine) {
+                inject::BuildKeystrokePlan(plan, chunk, resolvedMode, layout, target, config, column);
             }
-
-            // Normalized newline handling - single unified pause
-            inject::DrainInputQueue();
-            Sleep(config.baseKeystrokeDelayMs + NEWLINE_PAUSE_MS / 2);
-
-            // Send Enter key
-            inject::SendEnterKey();
-            charsSent++;
-            charsSinceNewline = 0;  // Reset line-start counter
-            if (progressCallback) progressCallback(charsSent, text.size());
-
-            // Brief pause after enter
-            Sleep(config.baseKeystrokeDelayMs + NEWLINE_PAUSE_MS / 2);
-            inject::DrainInputQueue();
+            column = endsLine ? 0 : plan.endColumn;
+            charsSent = chunkEnd;
+            typed.Advance(chunk, chunkStart, charsSent, lineStart);
+            chunkStart = chunkEnd;
             continue;
         }
 
-        // Accumulate character using appropriate mode
-        size_t bufferSizeBefore = buffer.size();
-        inject::AppendCharacterWithMode(buffer, c, resolvedMode, layout);
-        charsInBuffer++;
-        charsSinceNewline++;
-
-        // Determine chunk size based on pacing strategy
-        int effectiveChunkSize = (config.strategy == PacingStrategy::Burst) ? CHUNK_SIZE : 1;
-
-        // Flush at chunk boundary
-        if (charsInBuffer >= static_cast<size_t>(effectiveChunkSize)) {
-            if (diag) diag->totalEventsAttempted += buffer.size();
-
-            if (config.strategy == PacingStrategy::Burst) {
-                if (!inject::FlushInputs(buffer, diag ? &diag->totalEventsSent : nullptr)) {
-                    inject::ResetModifiers();
-                    inject::RemoveAbortHook();
-                    if (diag) {
-                        diag->endTime = GetTickCount();
-                        diag->totalCharsSent = charsSent;
-                        diag->RecordError(L"FlushInputs failed");
-                    }
-                    return charsSent;
-                }
-            } else {
-                size_t sent = inject::FlushInputsWithPacing(buffer, config, diag);
-                if (diag) diag->totalEventsSent += sent;
-            }
-
-            charsSent += charsInBuffer;
-            charsInBuffer = 0;
-            if (progressCallback) progressCallback(charsSent, text.size());
-
-            // Calculate pause
-            int pauseMs = config.baseKeystrokeDelayMs;
-
-            if (config.strategy == PacingStrategy::Burst) {
-                pauseMs += INTER_CHUNK_PAUSE_MS;
-            } else if (config.strategy == PacingStrategy::PerCharacter) {
-                pauseMs += config.perCharDelayMs;
-            }
-
-            // Line-start guard: extra delay for first few chars after newline
-            if (charsSinceNewline <= static_cast<size_t>(config.lineStartGuardChars)) {
-                pauseMs += config.lineStartGuardMs;
-            }
-
-            if (pauseMs > 0) {
-                Sleep(pauseMs);
-            }
-
-            if (config.strategy == PacingStrategy::Burst) {
-                inject::DrainInputQueue();
+        // Compile the chunk's keystroke plan before its first event goes out
+        LONGLONG planStart = inject::QpcNow();
+        bool planCached = inject::IsPlanCurrent(plan, chunk, resolvedMode, layout, target, config, column);
+        if (!planCached) {
+            inject::BuildKeystrokePlan(plan, chunk, resolvedMode, layout, target, config, column);
+        }
+        if (diag) {
+            diag->planChunks++;
+            diag->planOps = (std::max)(diag->planOps, plan.ops.size());
+            diag->planBuildMs += inject::QpcToMs(inject::QpcNow() - planStart);
+            diag->planCached = planCached && diag->planChunks == 1;
+            diag->transliteratedChars += plan.transliteratedChars;
+            if (resolvedMode == InjectionMode::Hybrid) {
+                diag->encodingUnicodeChars += plan.unicodeChars;
+                diag->encodingCostMs += plan.costMs;
+                diag->encodingVKOnlyCostMs += plan.vkOnlyCostMs;
             }
         }
-    }
-
-    // Flush remaining
-    if (!buffer.empty()) {
-        if (diag) diag->totalEventsAttempted += buffer.size();
 
-        if (config.strategy == PacingStrategy::Burst) {
-            if (!inject::FlushInputs(buffer, diag ? &diag->totalEventsSent : nullptr)) {
-                inject::ResetModifiers();
-                inject::RemoveAbortHook();
-                if (diag) {
-                    diag->endTime = GetTickCount();
-                    diag->totalCharsSent = charsSent;
-                    diag->RecordError(L"FlushInputs failed at end");
-                }
-                return charsSent;
-            }
-        } else {
-            size_t sent = inject::FlushInputsWithPacing(buffer, config, diag);
-            if (diag) diag->totalEventsSent += sent;
+        inject::InjectionCursor cursor =
+            inject::SeekPlan(plan, startUnits > chunkStart ? startUnits - chunkStart : 0);
+        if (diag && startUnits > 0 && diag->resumedFromChars == 0) {
+            diag->resumedFromChars = chunkStart + cursor.units;
         }
-        charsSent += charsInBuffer;
-        if (progressCallback) progressCallback(charsSent, text.size());
+
+        outcome = inject::ExecuteKeystrokePlan(plan, config, scheduler, backpressure, session,
+                                               diag, channel, clientInfo.hwnd, chunkStart, cursor);
+        charsSent = chunkStart + cursor.units;
+        // A line continued from the previous chunk keeps its start unless one ended here
+        if (!midLine || cursor.lineStart > 0) lineStart = chunkStart + cursor.lineStart;
+        column = endsLine ? 0 : plan.endColumn;
+        typed.Advance(chunk, chunkStart, charsSent, lineStart);
+        chunkStart = chunkEnd;
     }
+    LONGLONG stoppedQpc = inject::QpcNow();
 
-    // Reset modifiers at end
+    // Reset modifiers at end (also releases any Shift held when stopping early)
     inject::ResetModifiers();
-    inject::RemoveAbortHook();
+
+    // The reader stops at its next block when injection stopped early
+    StopTextStream(stream);
+    if (stream.failed) {
+        if (diag) diag->RecordError(stream.error);
+        if (outcome == inject::PasteOutcome::Completed) outcome = inject::PasteOutcome::Failed;
+    } else if (stream.stopped && outcome == inject::PasteOutcome::Completed) {
+        // ESC reached the reader first and the ring ran dry between batches
+        outcome = inject::PasteOutcome::Aborted;
+    }
 
     if (diag) {
         diag->endTime = GetTickCount();
         diag->totalCharsSent = charsSent;
+        if (!stream.stopped) diag->totalCharsRequested = stream.totalUnits;  // Else the estimate stands
+        diag->RecordPacing(scheduler);
+        session.Report(*diag, config);
+        if (backpressure) diag->RecordBackpressure(*backpressure);
+        if (outcome == inject::PasteOutcome::Aborted) {
+            diag->RecordError(L"User cancelled with ESC");
+            LONGLONG abortQpc = inject::GetAbortRequestQpc();
+            if (abortQpc != 0) diag->abortLatencyMs = inject::QpcToMs(stoppedQpc - abortQpc);
+        }
     }
 
+    if (stop) {
+        stop->lineOffset = lineStart;
+        stop->sentHash = typed.sent;
+        stop->lineHash = typed.line;
+    }
+    inject::PublishOutcome(channel, outcome);
     return charsSent;
 }
 
@@ -1188,63 +3621,172 @@ size_t sendTextToWindowEx(const std::wstring& text, InjectionMode mode,
 std::wstring GetLogPath();
 void WriteDiagnosticLog(const std::wstring& content);
 
-// Forward declaration for progress callback
-void UpdateProgress(size_t current, size_t total);
+// Forward declarations for learned target profiles (Settings Persistence)
+inject::TargetProfile LoadTargetProfile(const std::wstring& key, const inject::PacingConfig& defaults);
+void SaveTargetProfile(const inject::TargetProfile& profile);
+
+// A paste in flight. Created and destroyed by the UI thread; between
+// StartPasteJob and the worker publishing its outcome, only the worker
+// touches anything but the channel.
+struct PasteJob {
+    TextStream stream;           // Source and reader; the worker consumes the text from it
+    InjectionMode mode;
+    inject::PacingConfig config;
+    inject::DiagnosticState diagState;
+    bool diagEnabled;
+    bool fromHotkey;             // Hotkey pastes don't own the ARM state
+    bool abortShown;             // UI has already shown the cancelling state
+    LONG pausedShown;            // PAUSED_* state the UI is showing
+    size_t startChars;           // Continues an interrupted paste from here (0 = from the start)
+    size_t charsSent;            // Final count, valid once outcome is published
+    StopPoint stop;              // Where it stopped and the hashes to resume it by (with charsSent)
+    inject::PasteChannel channel;
+    inject::RemoteClientInfo clientInfo; // Target detected once, before the worker starts
+    inject::TargetProfile profile; // Learned pacing for this target, updated when the job ends
+    HANDLE hThread;
+};
+
+static PasteJob* g_pasteJob = nullptr;
+
+// Where the last interrupted paste stopped, so the next ARM or hotkey paste
+// can type only the rest. Persisted as a checkpoint next to the INI; the text
+// itself is never written to disk, so clipboard pastes resume only while the
+// clipboard still holds the same text.
+struct ResumePoint {
+    bool valid;
+    bool armed;              // The next paste continues from here
+    bool restored;           // Loaded from the checkpoint (earlier run)
+    size_t charsSent;        // Exact stop position
+    size_t lineOffset;       // Start of the last line not fully sent
+    ULONGLONG sentHash;      // Normalized text before charsSent
+    ULONGLONG lineHash;      // Normalized text before lineOffset
+    bool fromFile;
+    std::wstring sourcePath; // File source (empty for clipboard)
+    std::wstring profileKey; // Target the paste was going to
+
+    // Set with armed: the offset the user accepted and the hash of the text before it
+    size_t armedOffset;
+    ULONGLONG armedPrefixHash;
+};
 
-// Progress callback wrapper for UpdateProgress
-void ProgressCallbackWrapper(size_t current, size_t total) {
-    UpdateProgress(current, total);
+static ResumePoint g_resumePoint = {};
+
+// Within a run the target still holds the partial line, so continue exactly
+// where injection stopped. After a restart (session drop, crash) the partial
+// line may be gone, so start again from the last fully sent line.
+size_t ResumeOffset() {
+    return g_resumePoint.restored ? g_resumePoint.lineOffset : g_resumePoint.charsSent;
 }
 
-// Original function - wrapper that auto-detects target and selects mode
-// Normalize typographic Unicode characters to ASCII equivalents
-// Prevents garbled output in remote desktop sessions (Citrix, RDP, VNC)
-std::wstring NormalizeSmartCharacters(const std::wstring& input) {
-    std::wstring result;
-    result.reserve(input.size());
-    for (wchar_t c : input) {
-        switch (c) {
-            case L'\u2018': // LEFT SINGLE QUOTATION MARK
-            case L'\u2019': // RIGHT SINGLE QUOTATION MARK
-                result += L'\'';
-                break;
-            case L'\u201C': // LEFT DOUBLE QUOTATION MARK
-            case L'\u201D': // RIGHT DOUBLE QUOTATION MARK
-                result += L'"';
-                break;
-            case L'\u2013': // EN DASH
-            case L'\u2014': // EM DASH
-                result += L'-';
-                break;
-            case L'\u2026': // HORIZONTAL ELLIPSIS
-                result += L"...";
-                break;
-            default:
-                result += c;
-                break;
-        }
-    }
-    return result;
+// Does the source still start with the text typed before the resume offset?
+// Reads the source up to the offset; prefixHash gets the hash of that text
+bool MatchesResumePoint(const PasteSource& source, ULONGLONG& prefixHash) {
+    if (!g_resumePoint.valid) return false;
+    ULONGLONG expected = g_resumePoint.restored ? g_resumePoint.lineHash : g_resumePoint.sentHash;
+    return HashSourcePrefix(source, ResumeOffset(), prefixHash) && prefixHash == expected;
+}
+
+// Forward declarations for the resume checkpoint (Settings Persistence)
+void SaveCheckpoint(const ResumePoint& point);
+void ClearCheckpoint();
+
+// Ask whether to continue an interrupted paste when the source matches it
+// The only read of the source before typing, and only up to the offset; the
+// paste job takes the verified offset and prefix hash from here.
+// Returns false if the user cancelled the paste altogether
+bool OfferResume(const PasteSource& source) {
+    g_resumePoint.armed = false;
+    if (!g_resumePoint.valid) return true;
+
+    size_t offset = ResumeOffset();
+    ULONGLONG prefixHash = 0;
+    if (!MatchesResumePoint(source, prefixHash)) return true;
+
+    std::wstring sourceName = g_resumePoint.fromFile ? g_resumePoint.sourcePath : std::wstring(L"clipboard text");
+    wchar_t prompt[512];
+    swprintf_s(prompt, L"The last paste of this %s stopped after %zu characters%s.\n\n"
+                       L"Yes - continue from character %zu\nNo - start over",
+        g_resumePoint.fromFile ? L"file" : L"text", g_resumePoint.charsSent,
+        g_resumePoint.restored ? L" in an earlier session" : L"", offset);
+    std::wstring message = prompt;
+    message += L"\n\nSource: " + sourceName;
+    if (!g_resumePoint.profileKey.empty()) message += L"\nTarget: " + g_resumePoint.profileKey;
+
+    int choice = MessageBoxW(g_app.hwndMain, message.c_str(), L"MadPaster - Resume",
+                             MB_YESNOCANCEL | MB_ICONQUESTION | MB_TOPMOST);
+    if (choice == IDCANCEL) return false;
+    g_resumePoint.armed = (choice == IDYES);
+    g_resumePoint.armedOffset = offset;
+    g_resumePoint.armedPrefixHash = prefixHash;
+    return true;
 }
 
-size_t sendTextToWindow(const std::wstring& text, bool showProgress = false) {
-    // Normalize smart quotes/dashes to ASCII for remote desktop compatibility
-    std::wstring normalizedText = NormalizeSmartCharacters(text);
+// Paste worker thread - runs the injection loop off the UI thread
+DWORD WINAPI PasteWorkerProc(LPVOID param) {
+    PasteJob* job = static_cast<PasteJob*>(param);
 
-    // Detect remote client
-    inject::RemoteClientInfo clientInfo = inject::DetectRemoteClient();
+    // Pacing accuracy matters more than fairness while injecting
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_ABOVE_NORMAL);
 
-    // Get appropriate pacing config
-    inject::PacingConfig config = inject::GetDefaultPacingConfig(clientInfo.isRemote);
+    // Diagnostics are always collected; they feed the target profile
+    job->charsSent = sendStreamToWindow(job->stream, job->mode, job->config, job->clientInfo,
+                                        &job->diagState, &job->channel, job->startChars,
+                                        &job->stop, job->fromHotkey);
+    return 0;
+}
 
-    // Optional diagnostic state when enabled
-    inject::DiagnosticState* diag = nullptr;
-    inject::DiagnosticState diagState;
-    if (g_app.diagnosticMode) {
-        diag = &diagState;
+// Prepare a paste job - auto-detects target and selects pacing
+// Runs on the UI thread before the worker starts; triggerQpc is when the paste was requested
+// Takes over the source's text (swapped, not copied)
+PasteJob* CreatePasteJob(PasteSource& takeSource, bool fromHotkey, LONGLONG triggerQpc) {
+    PasteJob* job = new PasteJob();
+
+    // The worker streams the text; smart quotes/dashes are normalized as it is read
+    std::swap(job->stream.source, takeSource);
+    const PasteSource& source = job->stream.source;
+    job->fromHotkey = fromHotkey;
+    job->abortShown = false;
+    job->pausedShown = inject::PAUSED_NONE;
+    job->charsSent = 0;
+    job->stop = StopPoint();
+    job->hThread = nullptr;
+    job->channel.charsTotal = static_cast<LONG>(source.estimatedUnits);
+
+    // Continue an interrupted paste when the user asked for it. OfferResume
+    // checked the text before the offset; the reader checks it again as it
+    // streams, so an edit since the prompt stops the paste untyped.
+    job->startChars = 0;
+    if (g_resumePoint.armed) {
+        job->startChars = g_resumePoint.armedOffset;
+        job->stream.verifyUnits = g_resumePoint.armedOffset;
+        job->stream.verifyHash = g_resumePoint.armedPrefixHash;
+    }
+    g_resumePoint.armed = false;
+
+    // Detect remote client (the worker reuses this instead of detecting again)
+    job->clientInfo = inject::DetectRemoteClient();
+    const inject::RemoteClientInfo& clientInfo = job->clientInfo;
 
+    // Start from the class defaults, then apply what earlier pastes learned about this target
+    job->config = inject::GetDefaultPacingConfig(clientInfo.targetClass);
+    job->profile = LoadTargetProfile(inject::MakeProfileKey(clientInfo), job->config);
+    inject::ApplyTargetProfile(job->config, job->profile);
+
+    // Use configured injection mode (default: Auto)
+    job->mode = g_app.injectionMode;
+
+    inject::DiagnosticState* diag = &job->diagState;
+    diag->totalCharsRequested = source.estimatedUnits;
+    diag->triggerQpc = triggerQpc;
+    diag->focusQpc = inject::QpcNow();
+    diag->profileKey = job->profile.key;
+    diag->profileLoaded = job->profile.loaded;
+    diag->profilePastes = job->profile.pastes;
+
+    // Report context only when diagnostics are shown
+    job->diagEnabled = g_app.diagnosticMode;
+    if (job->diagEnabled) {
         // Populate context info
-        diag->totalCharsRequested = normalizedText.length();
         diag->targetClassName = clientInfo.className;
         diag->targetIsRemote = clientInfo.isRemote;
 
@@ -1270,28 +3812,30 @@ size_t sendTextToWindow(const std::wstring& text, bool showProgress = false) {
         }
     }
 
-    // Use configured injection mode (default: Auto)
-    InjectionMode mode = g_app.injectionMode;
+    return job;
+}
 
-    // Set up progress callback if requested
-    ProgressCallback progressCb = showProgress ? ProgressCallbackWrapper : nullptr;
+// Launch the worker for a prepared job
+bool StartPasteJob(PasteJob* job) {
+    job->hThread = CreateThread(nullptr, 0, PasteWorkerProc, job, 0, nullptr);
+    return (job->hThread != nullptr);
+}
 
-    size_t result = sendTextToWindowEx(normalizedText, mode, config, diag, progressCb);
+// Log and display diagnostics for a finished job (UI thread)
+void ReportPasteDiagnostics(PasteJob* job) {
+    if (!job->diagEnabled) return;
 
-    // Log and display diagnostics if enabled
-    if (diag) {
-        // Write to debug output (for DebugView)
-        OutputDebugStringW(diag->GetSummary().c_str());
+    inject::DiagnosticState* diag = &job->diagState;
 
-        // Write to log file
-        WriteDiagnosticLog(diag->GetSummary(false));
+    // Write to debug output (for DebugView)
+    OutputDebugStringW(diag->GetSummary().c_str());
 
-        // Show message box (use topmost so it appears over other windows)
-        MessageBoxW(nullptr, diag->GetSummary(true).c_str(),
-                    L"MadPaster - Injection Diagnostics", MB_OK | MB_ICONINFORMATION | MB_TOPMOST);
-    }
+    // Write to log file
+    WriteDiagnosticLog(diag->GetSummary(false));
 
-    return result;
+    // Show message box (use topmost so it appears over other windows)
+    MessageBoxW(nullptr, diag->GetSummary(true).c_str(),
+                L"MadPaster - Injection Diagnostics", MB_OK | MB_ICONINFORMATION | MB_TOPMOST);
 }
 
 // ============================================================================
@@ -1312,6 +3856,64 @@ std::wstring GetIniPath() {
     return iniPath;
 }
 
+// Resume checkpoint for an interrupted paste, next to the INI
+// Holds the offsets, hashes of the text before them and the source - never the text itself
+std::wstring GetCheckpointPath() {
+    std::wstring path = GetIniPath();
+    size_t pos = path.rfind(L".ini");
+    if (pos != std::wstring::npos) path.erase(pos);
+    return path + L"-resume.ini";
+}
+
+void SaveCheckpoint(const ResumePoint& point) {
+    std::wstring path = GetCheckpointPath();
+    wchar_t sentHash[32];
+    wchar_t lineHash[32];
+    swprintf_s(sentHash, L"%016llX", point.sentHash);
+    swprintf_s(lineHash, L"%016llX", point.lineHash);
+
+    WritePrivateProfileStringW(L"Checkpoint", L"CharsSent",
+        std::to_wstring(point.charsSent).c_str(), path.c_str());
+    WritePrivateProfileStringW(L"Checkpoint", L"SentHash", sentHash, path.c_str());
+    WritePrivateProfileStringW(L"Checkpoint", L"LineOffset",
+        std::to_wstring(point.lineOffset).c_str(), path.c_str());
+    WritePrivateProfileStringW(L"Checkpoint", L"LineHash", lineHash, path.c_str());
+    WritePrivateProfileStringW(L"Checkpoint", L"Source",
+        point.fromFile ? L"file" : L"clipboard", path.c_str());
+    WritePrivateProfileStringW(L"Checkpoint", L"Path", point.sourcePath.c_str(), path.c_str());
+    WritePrivateProfileStringW(L"Checkpoint", L"Profile", point.profileKey.c_str(), path.c_str());
+}
+
+void LoadCheckpoint() {
+    std::wstring path = GetCheckpointPath();
+    wchar_t buffer[MAX_PATH];
+    GetPrivateProfileStringW(L"Checkpoint", L"LineHash", L"", buffer, MAX_PATH, path.c_str());
+    if (buffer[0] == L'\0') return;  // No interrupted paste (or one from an older version)
+
+    ResumePoint point = {};
+    point.lineHash = wcstoull(buffer, nullptr, 16);
+    GetPrivateProfileStringW(L"Checkpoint", L"SentHash", L"", buffer, MAX_PATH, path.c_str());
+    point.sentHash = wcstoull(buffer, nullptr, 16);
+    point.charsSent = GetPrivateProfileIntW(L"Checkpoint", L"CharsSent", 0, path.c_str());
+    point.lineOffset = GetPrivateProfileIntW(L"Checkpoint", L"LineOffset", 0, path.c_str());
+    if (point.charsSent == 0 || point.lineOffset > point.charsSent) return;
+
+    GetPrivateProfileStringW(L"Checkpoint", L"Source", L"clipboard", buffer, MAX_PATH, path.c_str());
+    point.fromFile = (_wcsicmp(buffer, L"file") == 0);
+    GetPrivateProfileStringW(L"Checkpoint", L"Path", L"", buffer, MAX_PATH, path.c_str());
+    point.sourcePath = buffer;
+    GetPrivateProfileStringW(L"Checkpoint", L"Profile", L"", buffer, MAX_PATH, path.c_str());
+    point.profileKey = buffer;
+
+    point.valid = true;
+    point.restored = true;
+    g_resumePoint = point;
+}
+
+void ClearCheckpoint() {
+    DeleteFileW(GetCheckpointPath().c_str());
+}
+
 std::wstring GetLogPath() {
     wchar_t exePath[MAX_PATH];
     GetModuleFileNameW(NULL, exePath, MAX_PATH);
@@ -1362,6 +3964,23 @@ void WriteDiagnosticLog(const std::wstring& content) {
     CloseHandle(hFile);
 }
 
+// Line continuation character by shell name (0 = none)
+wchar_t ParseLineContinuation(const wchar_t* str) {
+    if (_wcsicmp(str, L"bash") == 0) return L'\\';
+    if (_wcsicmp(str, L"powershell") == 0) return L'`';
+    if (_wcsicmp(str, L"cmd") == 0) return L'^';
+    return 0;
+}
+
+const wchar_t* LineContinuationToString(wchar_t ch) {
+    switch (ch) {
+        case L'\\': return L"bash";
+        case L'`': return L"powershell";
+        case L'^': return L"cmd";
+        default: return L"none";
+    }
+}
+
 // Convert string to InjectionMode enum
 InjectionMode ParseInjectionMode(const wchar_t* str) {
     if (_wcsicmp(str, L"unicode") == 0) return InjectionMode::Unicode;
@@ -1410,6 +4029,26 @@ void LoadSettings() {
 
     // Silent mode (stay in tray after hotkey paste)
     g_app.silentMode = (GetPrivateProfileIntW(L"Settings", L"SilentMode", 0, iniPath.c_str()) != 0);
+
+    // Long-line handling for terminal line editors (default off)
+    g_app.columnPacing = (GetPrivateProfileIntW(L"Settings", L"ColumnPacing", 0, iniPath.c_str()) != 0);
+    g_app.lineSplitColumn = GetPrivateProfileIntW(L"Settings", L"LineSplitColumn", 0, iniPath.c_str());
+    if (g_app.lineSplitColumn < 0) g_app.lineSplitColumn = 0;
+    if (g_app.lineSplitColumn > 0 && g_app.lineSplitColumn < 40) g_app.lineSplitColumn = 40;
+
+    wchar_t continuation[32];
+    GetPrivateProfileStringW(L"Settings", L"LineContinuation", L"bash", continuation, 32, iniPath.c_str());
+    g_app.lineContinuation = ParseLineContinuation(continuation);
+
+    // Spell out characters the target layout lacks (default off: Unicode packets)
+    g_app.transliterate = (GetPrivateProfileIntW(L"Settings", L"Transliterate", 0, iniPath.c_str()) != 0);
+
+    // Batch sizes used to be learned per window class alone; target profiles
+    // relearn them within a few pastes, so just drop the old section
+    WritePrivateProfileStringW(L"BatchSizes", nullptr, nullptr, iniPath.c_str());
+
+    // Interrupted paste from an earlier run
+    LoadCheckpoint();
 }
 
 void SaveSettings() {
@@ -1429,6 +4068,154 @@ void SaveSettings() {
         g_app.diagnosticMode ? L"1" : L"0", iniPath.c_str());
     WritePrivateProfileStringW(L"Settings", L"SilentMode",
         g_app.silentMode ? L"1" : L"0", iniPath.c_str());
+    WritePrivateProfileStringW(L"Settings", L"ColumnPacing",
+        g_app.columnPacing ? L"1" : L"0", iniPath.c_str());
+    WritePrivateProfileStringW(L"Settings", L"LineSplitColumn",
+        std::to_wstring(g_app.lineSplitColumn).c_str(), iniPath.c_str());
+    WritePrivateProfileStringW(L"Settings", L"LineContinuation",
+        LineContinuationToString(g_app.lineContinuation), iniPath.c_str());
+    WritePrivateProfileStringW(L"Settings", L"Transliterate",
+        g_app.transliterate ? L"1" : L"0", iniPath.c_str());
+}
+
+// Learned target profiles, one [Profile <class>|<image>] section per target
+PacingStrategy ParsePacingStrategy(const wchar_t* value, PacingStrategy fallback) {
+    if (_wcsicmp(value, L"Burst") == 0) return PacingStrategy::Burst;
+    if (_wcsicmp(value, L"PerCharacter") == 0) return PacingStrategy::PerCharacter;
+    if (_wcsicmp(value, L"PerEvent") == 0) return PacingStrategy::PerEvent;
+    if (_wcsicmp(value, L"Adaptive") == 0) return PacingStrategy::Adaptive;
+    if (_wcsicmp(value, L"LineBurst") == 0) return PacingStrategy::LineBurst;
+    if (_wcsicmp(value, L"TokenBucket") == 0) return PacingStrategy::TokenBucket;
+    return fallback;
+}
+
+const wchar_t* PacingStrategyToString(PacingStrategy strategy) {
+    switch (strategy) {
+        case PacingStrategy::Burst:        return L"Burst";
+        case PacingStrategy::PerCharacter: return L"PerCharacter";
+        case PacingStrategy::PerEvent:     return L"PerEvent";
+        case PacingStrategy::Adaptive:     return L"Adaptive";
+        case PacingStrategy::LineBurst:    return L"LineBurst";
+        case PacingStrategy::TokenBucket:  return L"TokenBucket";
+    }
+    return L"Adaptive";
+}
+
+// Section names can't contain '[' or ']'; keep '=' and ';' out as well
+std::wstring ProfileSection(const std::wstring& key) {
+    std::wstring section = L"Profile " + key;
+    for (wchar_t& c : section) {
+        if (c == L'=' || c == L';' || c == L'[' || c == L']') c = L'_';
+    }
+    return section;
+}
+
+inject::TargetProfile LoadTargetProfile(const std::wstring& key, const inject::PacingConfig& defaults) {
+    inject::TargetProfile profile = inject::MakeDefaultProfile(key, defaults);
+    std::wstring iniPath = GetIniPath();
+    std::wstring section = ProfileSection(key);
+    const wchar_t* s = section.c_str();
+
+    wchar_t buffer[32];
+    GetPrivateProfileStringW(s, L"Strategy", L"", buffer, 32, iniPath.c_str());
+    if (buffer[0] == L'\0') return profile;  // No profile for this target yet
+
+    // The tuned values belong to the strategy they were learned under. If the
+    // class defaults have moved on (reclassified target, new version), start over.
+    if (ParsePacingStrategy(buffer, defaults.strategy) != defaults.strategy) return profile;
+
+    profile.loaded = true;
+    profile.perEventDelayMs = inject::ClampInt(
+        GetPrivateProfileIntW(s, L"PerEventDelay", profile.perEventDelayMs, iniPath.c_str()),
+        0, PROFILE_MAX_EVENT_MS);
+    profile.perCharDelayMs = inject::ClampInt(
+        GetPrivateProfileIntW(s, L"PerCharDelay", profile.perCharDelayMs, iniPath.c_str()),
+        PROFILE_MIN_CHAR_MS, PROFILE_MAX_CHAR_MS);
+    profile.newlinePauseMs = inject::ClampInt(
+        GetPrivateProfileIntW(s, L"NewlinePause", profile.newlinePauseMs, iniPath.c_str()),
+        PROFILE_MIN_NEWLINE_MS, PROFILE_MAX_NEWLINE_MS);
+    profile.lineStartGuardMs = inject::ClampInt(
+        GetPrivateProfileIntW(s, L"LineStartDelay", profile.lineStartGuardMs, iniPath.c_str()),
+        0, PROFILE_MAX_GUARD_MS);
+    profile.bucketRatePerSec = inject::ClampInt(
+        GetPrivateProfileIntW(s, L"BucketRate", profile.bucketRatePerSec, iniPath.c_str()),
+        PROFILE_MIN_BUCKET_RATE, PROFILE_MAX_BUCKET_RATE);
+    profile.batchSize = inject::ClampInt(
+        GetPrivateProfileIntW(s, L"BatchSize", profile.batchSize, iniPath.c_str()),
+        0, LINE_BURST_MAX_EVENTS);
+    profile.pastes = GetPrivateProfileIntW(s, L"Pastes", 0, iniPath.c_str());
+    profile.cleanStreak = GetPrivateProfileIntW(s, L"CleanStreak", 0, iniPath.c_str());
+
+    // Hand-edited overrides of the long-line and transliteration settings
+    profile.columnPacing = GetPrivateProfileIntW(s, L"ColumnPacing", -1, iniPath.c_str());
+    profile.lineSplitColumn = GetPrivateProfileIntW(s, L"LineSplitColumn", -1, iniPath.c_str());
+    GetPrivateProfileStringW(s, L"LineContinuation", L"", buffer, 32, iniPath.c_str());
+    if (buffer[0] != L'\0') profile.lineContinuation = ParseLineContinuation(buffer);
+    profile.transliterate = GetPrivateProfileIntW(s, L"Transliterate", -1, iniPath.c_str());
+
+    return profile;
+}
+
+// Stamp the section as most recently used and drop the oldest profiles
+// beyond PROFILE_MAX_SECTIONS, so the INI doesn't grow with every app ever pasted into
+void TouchTargetProfile(const std::wstring& section) {
+    std::wstring iniPath = GetIniPath();
+
+    std::vector<wchar_t> names(4096);
+    while (GetPrivateProfileSectionNamesW(names.data(), static_cast<DWORD>(names.size()),
+                                          iniPath.c_str()) == names.size() - 2) {
+        names.resize(names.size() * 2);
+    }
+
+    struct Entry {
+        std::wstring section;
+        int lastUsed;
+    };
+    std::vector<Entry> profiles;
+    int newest = 0;
+    for (const wchar_t* name = names.data(); *name; name += wcslen(name) + 1) {
+        if (wcsncmp(name, L"Profile ", 8) != 0 || section == name) continue;
+        Entry entry = { name, static_cast<int>(GetPrivateProfileIntW(name, L"LastUsed", 0, iniPath.c_str())) };
+        newest = (std::max)(newest, entry.lastUsed);
+        profiles.push_back(entry);
+    }
+
+    WritePrivateProfileStringW(section.c_str(), L"LastUsed",
+        std::to_wstring(newest + 1).c_str(), iniPath.c_str());
+
+    if (profiles.size() < PROFILE_MAX_SECTIONS) return;
+    size_t excess = profiles.size() + 1 - PROFILE_MAX_SECTIONS;
+    std::partial_sort(profiles.begin(), profiles.begin() + excess, profiles.end(),
+                      [](const Entry& a, const Entry& b) { return a.lastUsed < b.lastUsed; });
+    for (size_t i = 0; i < excess; i++) {
+        WritePrivateProfileStringW(profiles[i].section.c_str(), nullptr, nullptr, iniPath.c_str());
+    }
+}
+
+void SaveTargetProfile(const inject::TargetProfile& profile) {
+    std::wstring iniPath = GetIniPath();
+    std::wstring section = ProfileSection(profile.key);
+    const wchar_t* s = section.c_str();
+
+    WritePrivateProfileStringW(s, L"Strategy", PacingStrategyToString(profile.strategy), iniPath.c_str());
+    WritePrivateProfileStringW(s, L"PerEventDelay",
+        std::to_wstring(profile.perEventDelayMs).c_str(), iniPath.c_str());
+    WritePrivateProfileStringW(s, L"PerCharDelay",
+        std::to_wstring(profile.perCharDelayMs).c_str(), iniPath.c_str());
+    WritePrivateProfileStringW(s, L"NewlinePause",
+        std::to_wstring(profile.newlinePauseMs).c_str(), iniPath.c_str());
+    WritePrivateProfileStringW(s, L"LineStartDelay",
+        std::to_wstring(profile.lineStartGuardMs).c_str(), iniPath.c_str());
+    WritePrivateProfileStringW(s, L"BucketRate",
+        std::to_wstring(profile.bucketRatePerSec).c_str(), iniPath.c_str());
+    WritePrivateProfileStringW(s, L"BatchSize",
+        std::to_wstring(profile.batchSize).c_str(), iniPath.c_str());
+    WritePrivateProfileStringW(s, L"Pastes",
+        std::to_wstring(profile.pastes).c_str(), iniPath.c_str());
+    WritePrivateProfileStringW(s, L"CleanStreak",
+        std::to_wstring(profile.cleanStreak).c_str(), iniPath.c_str());
+
+    TouchTargetProfile(section);
 }
 
 // ============================================================================
@@ -1586,7 +4373,7 @@ void CreateFloatingProgressWindow() {
 
     // Create the floating window (popup, always on top, no taskbar entry)
     g_app.hwndFloatingProgress = CreateWindowExW(
-        WS_EX_TOPMOST | WS_EX_TOOLWINDOW,
+        WS_EX_TOPMOST | WS_EX_TOOLWINDOW | WS_EX_NOACTIVATE,  // Clicking it must not pause the paste
         FLOATING_PROGRESS_CLASS,
         L"MadPaster",
         WS_POPUP,
@@ -1615,6 +4402,7 @@ void ShowProgress() {
     CreateFloatingProgressWindow();
     if (g_app.hwndFloatingProgress) {
         SendMessageW(g_app.hwndFloatingProgressBar, PBM_SETPOS, 0, 0);
+        SetWindowTextW(g_app.hwndFloatingLabel, L"Press ESC to cancel");
         ShowWindow(g_app.hwndFloatingProgress, SW_SHOWNOACTIVATE);
     }
     // Also update embedded progress bar
@@ -1635,8 +4423,11 @@ void HideProgress() {
     }
 }
 
+// Called from the paste poll timer - the UI thread's own message loop keeps it responsive
 void UpdateProgress(size_t current, size_t total) {
     if (total > 0) {
+        // Streamed files report an estimated total until they have been read
+        if (current > total) current = total;
         int percent = static_cast<int>((current * 100) / total);
         // Update floating progress bar
         if (g_app.hwndFloatingProgressBar) {
@@ -1647,75 +4438,241 @@ void UpdateProgress(size_t current, size_t total) {
             SendMessageW(g_app.hwndProgress, PBM_SETPOS, percent, 0);
         }
     }
-    // Pump messages to keep UI responsive
-    MSG msg;
-    while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
-        TranslateMessage(&msg);
-        DispatchMessage(&msg);
+}
+
+void ResetArmState() {
+    g_app.isArmed = false;
+    g_app.countdownRemaining = 0;
+
+    KillTimer(g_app.hwndMain, IDT_COUNTDOWN);
+
+    // Re-enable controls
+    EnableWindow(g_app.hwndRadioClipboard, TRUE);
+    EnableWindow(g_app.hwndRadioFile, TRUE);
+    EnableWindow(g_app.hwndButtonBrowse, !g_app.useClipboard);
+    EnableWindow(g_app.hwndEditDelay, TRUE);
+    EnableWindow(g_app.hwndSpinDelay, TRUE);
+    EnableWindow(g_app.hwndEditKeystroke, TRUE);
+    EnableWindow(g_app.hwndSpinKeystroke, TRUE);
+    EnableWindow(g_app.hwndComboMode, TRUE);
+    EnableWindow(g_app.hwndCheckDiag, TRUE);
+    EnableWindow(g_app.hwndCheckSilent, TRUE);
+
+    UpdateArmButtonText();
+    UpdateStatus(L"Ready - ARM Starts MadPaster  ESC Interrupts MadPaster");
+}
+
+// Hand text to the paste worker and start polling its progress channel
+void BeginPaste(PasteSource& source, bool fromHotkey, LONGLONG triggerQpc) {
+    PasteJob* job = CreatePasteJob(source, fromHotkey, triggerQpc);
+
+    // ESC hook (and, for adaptive pacing, the injected-event hook) run on their own thread
+    if (!inject::StartHookThread(job->config.strategy == PacingStrategy::Adaptive)) {
+        delete job;
+        MessageBox(NULL, L"Could not install the ESC keyboard hook, so the paste could not be "
+                         L"interrupted. The paste was not started.",
+                   L"MadPaster - Error", MB_OK | MB_ICONERROR | MB_TOPMOST);
+        if (!fromHotkey) ResetArmState();
+        return;
+    }
+
+    ShowProgress();
+    if (!StartPasteJob(job)) {
+        inject::StopHookThread();
+        HideProgress();
+        delete job;
+        MessageBox(NULL, L"Failed to start paste worker.", L"MadPaster - Error",
+                   MB_OK | MB_ICONERROR | MB_TOPMOST);
+        if (!fromHotkey) ResetArmState();
+        return;
+    }
+
+    g_pasteJob = job;
+    SetTimer(g_app.hwndMain, IDT_PASTE_POLL, PASTE_POLL_INTERVAL_MS, NULL);
+}
+
+// Collect a finished job and restore the UI
+void FinishPaste() {
+    PasteJob* job = g_pasteJob;
+    g_pasteJob = nullptr;
+
+    KillTimer(g_app.hwndMain, IDT_PASTE_POLL);
+    WaitForSingleObject(job->hThread, INFINITE);
+    CloseHandle(job->hThread);
+
+    inject::StopHookThread();
+    HideProgress();
+    ReportPasteDiagnostics(job);
+
+    inject::PasteOutcome outcome = inject::ReadOutcome(&job->channel);
+    inject::UpdateTargetProfile(job->profile, job->diagState, outcome);
+    SaveTargetProfile(job->profile);
+
+    bool completed = (outcome == inject::PasteOutcome::Completed);
+    const TextStream& stream = job->stream;
+    std::wstring msg = L"Interrupted at " + std::to_wstring(job->charsSent);
+    if (!stream.stopped) msg += L" / " + std::to_wstring(stream.totalUnits);
+    msg += L" characters";
+    if (stream.changed) msg = L"Not resumed - the text changed since the resume prompt";
+
+    // Remember where an interrupted paste stopped so the next paste can continue it
+    // (not after a read error, and not when the reader saw the whole text go out)
+    bool remaining = stream.stopped || job->charsSent < stream.totalUnits;
+    if (!completed && !stream.failed && job->charsSent > 0 && remaining) {
+        g_resumePoint.valid = true;
+        g_resumePoint.armed = false;
+        g_resumePoint.restored = false;
+        g_resumePoint.charsSent = job->charsSent;
+        g_resumePoint.lineOffset = job->stop.lineOffset;
+        g_resumePoint.sentHash = job->stop.sentHash;
+        g_resumePoint.lineHash = job->stop.lineHash;
+        g_resumePoint.fromFile = stream.source.fromFile;
+        g_resumePoint.sourcePath = stream.source.filePath;
+        g_resumePoint.profileKey = job->profile.key;
+        SaveCheckpoint(g_resumePoint);
+        msg += L" - paste again to resume";
+    } else if (completed && g_resumePoint.valid) {
+        g_resumePoint = ResumePoint();
+        ClearCheckpoint();
+    }
+
+    if (job->fromHotkey) {
+        if (!completed) {
+            RestoreFromTray();
+            UpdateStatus(msg.c_str());
+        } else if (!g_app.silentMode) {
+            // Restore from tray after successful paste (unless silent mode)
+            RestoreFromTray();
+        }
+    } else {
+        ResetArmState();
+        if (!completed) {
+            // User pressed ESC - restore window and show progress
+            RestoreFromTray();
+            UpdateStatus(msg.c_str());
+        }
+    }
+
+    delete job;
+}
+
+// Paste poll timer - drain the progress channel and detect completion
+void PollPasteJob() {
+    if (!g_pasteJob) {
+        KillTimer(g_app.hwndMain, IDT_PASTE_POLL);
+        return;
+    }
+
+    inject::PasteChannel& channel = g_pasteJob->channel;
+    UpdateProgress(static_cast<size_t>(inject::ReadChannel(&channel.charsSent)),
+                   static_cast<size_t>(inject::ReadChannel(&channel.charsTotal)));
+
+    if (!g_pasteJob->abortShown && inject::ReadChannel(&channel.aborting)) {
+        g_pasteJob->abortShown = true;
+        if (g_app.hwndFloatingLabel) SetWindowTextW(g_app.hwndFloatingLabel, L"Cancelling...");
+    }
+
+    LONG paused = inject::ReadChannel(&channel.paused);
+    if (!g_pasteJob->abortShown && paused != g_pasteJob->pausedShown) {
+        g_pasteJob->pausedShown = paused;
+        if (g_app.hwndFloatingLabel) {
+            SetWindowTextW(g_app.hwndFloatingLabel,
+                paused == inject::PAUSED_FOCUS ? L"Paused - focus the target window" :
+                paused == inject::PAUSED_USER  ? L"Paused - CTRL+ALT+P resumes" :
+                                                 L"Press ESC to cancel");
+        }
+    }
+
+    if (inject::ReadOutcome(&channel) != inject::PasteOutcome::Running) {
+        FinishPaste();
     }
 }
 
-void ResetArmState() {
-    g_app.isArmed = false;
-    g_app.countdownRemaining = 0;
+// A paste waiting for the target window to settle in the foreground
+struct PendingPaste {
+    PasteSource source;
+    bool fromHotkey;
+    bool active;
+    LONGLONG triggerQpc;      // Hotkey press or countdown end
+};
+
+static PendingPaste g_pendingPaste = {};
+
+bool IsPasteStarting() {
+    return g_pendingPaste.active || g_pasteJob;
+}
+
+// Start the pending paste once a window other than ours has been in front for
+// FOCUS_SETTLE_MS. Called straight away, on every foreground change and on the
+// settle timer; when focus is already stable the paste starts immediately.
+void TryStartPendingPaste() {
+    if (!g_pendingPaste.active) return;
 
-    KillTimer(g_app.hwndMain, IDT_COUNTDOWN);
+    HWND hwndFg = GetForegroundWindow();
+    bool settled = (hwndFg != NULL && hwndFg != g_app.hwndMain &&
+                    inject::ForegroundStableMs(hwndFg) >= FOCUS_SETTLE_MS);
+    bool timedOut = inject::QpcToMs(inject::QpcNow() - g_pendingPaste.triggerQpc) >= FOCUS_TIMEOUT_MS;
+    if (!settled && !timedOut) {
+        SetTimer(g_app.hwndMain, IDT_FOCUS_SETTLE, FOCUS_POLL_MS, NULL);
+        return;
+    }
 
-    // Re-enable controls
-    EnableWindow(g_app.hwndRadioClipboard, TRUE);
-    EnableWindow(g_app.hwndRadioFile, TRUE);
-    EnableWindow(g_app.hwndButtonBrowse, !g_app.useClipboard);
-    EnableWindow(g_app.hwndEditDelay, TRUE);
-    EnableWindow(g_app.hwndSpinDelay, TRUE);
-    EnableWindow(g_app.hwndEditKeystroke, TRUE);
-    EnableWindow(g_app.hwndSpinKeystroke, TRUE);
-    EnableWindow(g_app.hwndComboMode, TRUE);
-    EnableWindow(g_app.hwndCheckDiag, TRUE);
-    EnableWindow(g_app.hwndCheckSilent, TRUE);
+    KillTimer(g_app.hwndMain, IDT_FOCUS_SETTLE);
+    g_pendingPaste.active = false;
 
-    UpdateArmButtonText();
-    UpdateStatus(L"Ready - ARM Starts MadPaster  ESC Interrupts MadPaster");
+    PasteSource source;
+    std::swap(source, g_pendingPaste.source);
+    BeginPaste(source, g_pendingPaste.fromHotkey, g_pendingPaste.triggerQpc);
 }
 
-void ExecutePaste() {
-    UpdateStatus(L"Executing...");
-    UpdateArmButtonText();
-
-    // Minimize to tray before pasting
+// Minimize and paste as soon as focus settles on the target window
+// Takes over the source's text (swapped, not copied)
+void AwaitTargetFocus(PasteSource& source, bool fromHotkey, LONGLONG triggerQpc) {
     MinimizeToTray();
 
-    // Wait for focus to stabilize on target window
-    // Requires 3 consecutive checks where a different window has focus
-    HWND hwndSelf = g_app.hwndMain;
-    int stableCount = 0;
-    DWORD startTime = GetTickCount();
-    const DWORD FOCUS_TIMEOUT_MS = 1000;  // Max wait time
-
-    while (stableCount < 3) {
-        Sleep(50);
-        HWND hwndFg = GetForegroundWindow();
-        if (hwndFg != hwndSelf && hwndFg != NULL) {
-            stableCount++;
-        } else {
-            stableCount = 0;
-        }
-        // Timeout check
-        if (GetTickCount() - startTime > FOCUS_TIMEOUT_MS) {
-            break;
-        }
-    }
+    std::swap(g_pendingPaste.source, source);
+    g_pendingPaste.fromHotkey = fromHotkey;
+    g_pendingPaste.triggerQpc = triggerQpc;
+    g_pendingPaste.active = true;
+    TryStartPendingPaste();
+}
 
-    // Get text content
-    std::wstring textContent;
-    bool success = false;
+// Abort a running paste and wait for the worker (used on exit)
+void CancelPasteAndWait() {
+    if (g_pendingPaste.active) {
+        KillTimer(g_app.hwndMain, IDT_FOCUS_SETTLE);
+        g_pendingPaste.active = false;
+        g_pendingPaste.source = PasteSource();
+    }
+    if (!g_pasteJob) return;
+    inject::RequestAbort();
+    WaitForSingleObject(g_pasteJob->hThread, INFINITE);
+    FinishPaste();
+}
 
+// Take the clipboard text, or check the selected file, for the current mode
+// Files are not read here - the paste worker streams them
+bool GetPasteSource(PasteSource& source) {
+    source = PasteSource();
     if (g_app.useClipboard) {
-        if (openClipboard()) {
-            textContent = getClipboardText();
-            closeClipboard();
-            success = !textContent.empty();
-        }
-    } else {
+        if (!openClipboard()) return false;
+        source.text = getClipboardText();
+        closeClipboard();
+        source.estimatedUnits = source.text.size();
+        return !source.text.empty();
+    }
+
+    source.fromFile = true;
+    source.filePath = g_app.selectedFilePath;
+    return checkSourceFile(source.filePath, source.estimatedUnits);
+}
+
+void ExecutePaste() {
+    LONGLONG triggerQpc = inject::QpcNow();
+    UpdateStatus(L"Executing...");
+    UpdateArmButtonText();
+
+    if (!g_app.useClipboard) {
         // Verify file still exists
         DWORD attrs = GetFileAttributesW(g_app.selectedFilePath.c_str());
         if (attrs == INVALID_FILE_ATTRIBUTES) {
@@ -1724,30 +4681,13 @@ void ExecutePaste() {
             ResetArmState();
             return;
         }
-        textContent = readFileContents(g_app.selectedFilePath, success);
-    }
-
-    if (success && !textContent.empty()) {
-        if (textContent.length() < static_cast<size_t>(maxchar)) {
-            ShowProgress();
-            size_t charsSent = sendTextToWindow(textContent, true);
-            HideProgress();
-            if (charsSent < textContent.length()) {
-                // User pressed ESC - restore window and show progress
-                RestoreFromTray();
-                ResetArmState();
-                std::wstring msg = L"Interrupted at " + std::to_wstring(charsSent) +
-                                   L" / " + std::to_wstring(textContent.length()) + L" characters";
-                UpdateStatus(msg.c_str());
-                return;
-            }
-        } else {
-            std::wstring message = L"Text exceeds maximum length (" +
-                std::to_wstring(maxchar) + L" characters).\n\nCurrent length: " +
-                std::to_wstring(textContent.length()) + L" characters.";
-            MessageBox(NULL, message.c_str(), L"MadPaster - Error",
-                MB_OK | MB_ICONWARNING | MB_TOPMOST);
-        }
+    }
+
+    PasteSource source;
+    if (GetPasteSource(source)) {
+        // Worker owns the paste from here; FinishPaste resets the ARM state
+        AwaitTargetFocus(source, false, triggerQpc);
+        return;
     }
 
     HideProgress();
@@ -1756,72 +4696,26 @@ void ExecutePaste() {
 
 // Execute immediate paste from global hotkey (CTRL+ALT+V)
 void ExecuteImmediatePaste() {
-    // Don't interrupt if already armed
-    if (g_app.isArmed) return;
+    LONGLONG triggerQpc = inject::QpcNow();
 
-    // Get text content based on mode
-    std::wstring text;
+    // Don't interrupt if already armed or pasting
+    if (g_app.isArmed || IsPasteStarting()) return;
 
-    if (g_app.useClipboard) {
-        if (!openClipboard()) return;
-        text = getClipboardText();
-        closeClipboard();
-    } else {
+    if (!g_app.useClipboard) {
         if (g_app.selectedFilePath.empty()) return;
         DWORD attrs = GetFileAttributesW(g_app.selectedFilePath.c_str());
         if (attrs == INVALID_FILE_ATTRIBUTES || (attrs & FILE_ATTRIBUTE_DIRECTORY)) return;
-        bool success = false;
-        text = readFileContents(g_app.selectedFilePath, success);
-        if (!success) return;
-    }
-
-    if (text.empty()) return;
-    if (text.length() >= static_cast<size_t>(maxchar)) {
-        MessageBox(NULL, L"Text exceeds maximum length.",
-                   L"MadPaster - Error", MB_OK | MB_ICONWARNING | MB_TOPMOST);
-        return;
-    }
-
-    // Minimize to tray before pasting
-    MinimizeToTray();
-
-    // Wait for focus to stabilize on target window
-    HWND hwndSelf = g_app.hwndMain;
-    int stableCount = 0;
-    DWORD startTime = GetTickCount();
-    const DWORD FOCUS_TIMEOUT_MS = 1000;
-
-    while (stableCount < 3) {
-        Sleep(50);
-        HWND hwndFg = GetForegroundWindow();
-        if (hwndFg != hwndSelf && hwndFg != NULL) {
-            stableCount++;
-        } else {
-            stableCount = 0;
-        }
-        if (GetTickCount() - startTime > FOCUS_TIMEOUT_MS) {
-            break;
-        }
     }
 
-    // Show progress bar and inject with ESC handling enabled
-    ShowProgress();
-    size_t charsSent = sendTextToWindow(text, true);
-    HideProgress();
+    // Get the source based on mode
+    PasteSource source;
+    if (!GetPasteSource(source)) return;
 
-    // Handle interruption
-    if (charsSent < text.length()) {
-        RestoreFromTray();
-        std::wstring msg = L"Interrupted at " + std::to_wstring(charsSent) +
-                           L" / " + std::to_wstring(text.length()) + L" characters";
-        UpdateStatus(msg.c_str());
-        return;
-    }
+    // Offer to continue an interrupted paste of the same text
+    if (!OfferResume(source)) return;
 
-    // Restore from tray after successful paste (unless silent mode)
-    if (!g_app.silentMode) {
-        RestoreFromTray();
-    }
+    // Show progress and inject on the worker with ESC handling enabled
+    AwaitTargetFocus(source, true, triggerQpc);
 }
 
 void StartArmCountdown() {
@@ -1855,6 +4749,13 @@ void StartArmCountdown() {
         }
     }
 
+    // Offer to continue an interrupted paste of the same text
+    g_resumePoint.armed = false;
+    if (g_resumePoint.valid) {
+        PasteSource source;
+        if (GetPasteSource(source) && !OfferResume(source)) return;
+    }
+
     // Save settings when ARMing
     SaveSettings();
 
@@ -2109,6 +5010,9 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             // Create tray icon
             CreateTrayIcon(hwnd);
 
+            // Track foreground changes so pastes start as soon as focus settles
+            inject::InstallForegroundTracker(hwnd);
+
             // Register global hotkey (CTRL+ALT+V)
             if (!RegisterHotKey(hwnd, IDH_PASTE_HOTKEY, MOD_CONTROL | MOD_ALT | MOD_NOREPEAT, 'V')) {
                 DWORD err = GetLastError();
@@ -2117,12 +5021,23 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                 MessageBoxW(hwnd, msg, L"MadPaster - Warning", MB_OK | MB_ICONWARNING);
             }
 
+            // Register pause/resume hotkey (CTRL+ALT+P); pasting works without it
+            if (!RegisterHotKey(hwnd, IDH_PAUSE_HOTKEY, MOD_CONTROL | MOD_ALT | MOD_NOREPEAT, 'P')) {
+                DWORD err = GetLastError();
+                wchar_t msg[160];
+                swprintf_s(msg, L"Failed to register CTRL+ALT+P pause hotkey (error %lu). Another app may have it. "
+                                L"Pastes can still be stopped with ESC.", err);
+                MessageBoxW(hwnd, msg, L"MadPaster - Warning", MB_OK | MB_ICONWARNING);
+            }
+
             break;
         }
 
         case WM_HOTKEY:
             if (wParam == IDH_PASTE_HOTKEY) {
                 ExecuteImmediatePaste();
+            } else if (wParam == IDH_PAUSE_HOTKEY && g_pasteJob) {
+                inject::TogglePause();
             }
             break;
 
@@ -2168,7 +5083,10 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                     break;
 
                 case IDC_BUTTON_ARM:
-                    if (g_app.isArmed) {
+                    if (g_pasteJob) {
+                        // Paste in progress - ask the worker to stop at the next boundary
+                        inject::RequestAbort();
+                    } else if (g_app.isArmed) {
                         CancelArm();
                     } else {
                         StartArmCountdown();
@@ -2177,7 +5095,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 
                 case IDM_TRAY_ARM:
                     // ARM from tray using last settings
-                    if (!g_app.isArmed) {
+                    if (!g_app.isArmed && !IsPasteStarting()) {
                         StartArmCountdown();
                     }
                     break;
@@ -2187,6 +5105,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                     break;
 
                 case IDM_TRAY_EXIT:
+                    CancelPasteAndWait();
                     SaveSettings();
                     RemoveTrayIcon();
                     DestroyWindow(hwnd);
@@ -2257,9 +5176,17 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                 } else {
                     UpdateArmButtonText();
                 }
+            } else if (wParam == IDT_PASTE_POLL) {
+                PollPasteJob();
+            } else if (wParam == IDT_FOCUS_SETTLE) {
+                TryStartPendingPaste();
             }
             break;
 
+        case WM_FOREGROUND_CHANGED:
+            TryStartPendingPaste();
+            break;
+
         case WM_TRAYICON:
             switch (lParam) {
                 case WM_LBUTTONUP:
@@ -2279,7 +5206,10 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             break;
 
         case WM_CLOSE:
+            CancelPasteAndWait();
             UnregisterHotKey(hwnd, IDH_PASTE_HOTKEY);
+            UnregisterHotKey(hwnd, IDH_PAUSE_HOTKEY);
+            inject::RemoveForegroundTracker();
             SaveSettings();
             RemoveTrayIcon();
             DestroyWindow(hwnd);
@@ -2313,12 +5243,819 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     return 0;
 }
 
+// ============================================================================
+// Benchmarks (--bench=<name>)
+// ============================================================================
+
+// Mixed code/config sample used to build benchmark corpora
+const wchar_t* BENCH_SAMPLE =
+    L"# Deploy settings for the staging cluster\r\n"
+    L"$ErrorActionPreference = 'Stop'\r\n"
+    L"Get-ChildItem -Path C:\\Logs -Filter *.log | Where-Object { $_.Length -gt 1MB }\r\n"
+    L"apiVersion: apps/v1\r\n"
+    L"kind: Deployment\r\n"
+    L"metadata:\r\n"
+    L"  name: web-frontend\r\n"
+    L"  labels: {app: \"web\", tier: \"frontend\"}\r\n"
+    L"for (int i = 0; i < MAX_RETRY_COUNT; ++i) { total += values[i] * 2; }\r\n"
+    L"export PATH=\"$HOME/.local/bin:$PATH\" && echo \"caf\u00E9 ready\"\r\n"
+    L"U2FsdGVkX1+vupppZksvRf5pq5g5XjFRIipRkwB0K1Y96Qsv2Lm+31cmzaAILwyt\r\n";
+
+// Repeat the sample until the corpus reaches the requested length
+std::wstring BuildBenchmarkCorpus(size_t length) {
+    std::wstring corpus;
+    corpus.reserve(length);
+    size_t sampleLength = wcslen(BENCH_SAMPLE);
+    while (corpus.size() < length) {
+        corpus.append(BENCH_SAMPLE, (std::min)(sampleLength, length - corpus.size()));
+    }
+    return corpus;
+}
+
+// The same corpus with every non-ASCII character replaced by '?'
+std::wstring BuildAsciiBenchmarkCorpus(size_t length) {
+    std::wstring corpus = BuildBenchmarkCorpus(length);
+    for (wchar_t& ch : corpus) {
+        if (ch >= 0x80) ch = L'?';
+    }
+    return corpus;
+}
+
+// Encode benchmark text as UTF-8, or as UTF-16 BE without a BOM
+std::string EncodeBenchmarkText(std::wstring_view text, bool utf16BigEndian) {
+    std::string bytes;
+    if (utf16BigEndian) {
+        bytes.reserve(text.size() * 2);
+        for (wchar_t ch : text) {
+            bytes += static_cast<char>(ch >> 8);
+            bytes += static_cast<char>(ch & 0xFF);
+        }
+        return bytes;
+    }
+    int length = WideCharToMultiByte(CP_UTF8, 0, text.data(), static_cast<int>(text.size()),
+                                     nullptr, 0, nullptr, nullptr);
+    bytes.resize(length);
+    WideCharToMultiByte(CP_UTF8, 0, text.data(), static_cast<int>(text.size()),
+                        &bytes[0], length, nullptr, nullptr);
+    return bytes;
+}
+
+// Best time in ms over runs timed calls of work(run), run 1..runs, after one
+// untimed warm-up call with run 0. setup(run) is called untimed before each.
+template <typename Work, typename Setup>
+double BestRunMs(int runs, Work work, Setup setup) {
+    setup(0);
+    work(0);
+    double bestMs = 1e30;
+    for (int run = 1; run <= runs; run++) {
+        setup(run);
+        LONGLONG start = inject::QpcNow();
+        work(run);
+        bestMs = (std::min)(bestMs, inject::QpcToMs(inject::QpcNow() - start));
+    }
+    return bestMs;
+}
+
+template <typename Work>
+double BestRunMs(int runs, Work work) {
+    return BestRunMs(runs, work, [](int) {});
+}
+
+// Benchmark report text: a title line, then lines added printf-style
+struct BenchmarkReport {
+    std::wstring text;
+
+    explicit BenchmarkReport(const wchar_t* title) : text(L"MadPaster Benchmark: ") {
+        text += title;
+        text += L"\r\n";
+    }
+
+    void Add(const wchar_t* format, ...) {
+        wchar_t line[256];
+        va_list args;
+        va_start(args, format);
+        vswprintf_s(line, _countof(line), format, args);
+        va_end(args);
+        text += line;
+    }
+};
+
+// Log and display a benchmark report the same way injection diagnostics are reported
+void ReportBenchmark(const BenchmarkReport& report) {
+    OutputDebugStringW(report.text.c_str());
+    WriteDiagnosticLog(report.text);
+    MessageBoxW(nullptr, report.text.c_str(), L"MadPaster - Benchmark",
+                MB_OK | MB_ICONINFORMATION | MB_TOPMOST);
+}
+
+// Character-to-key mapping throughput: per-character VkKeyScanExW calls vs layout table
+void BenchmarkKeyMapping() {
+    const size_t CORPUS_CHARS = 45000;
+    const int ITERATIONS = 20;
+
+    std::wstring corpus = BuildBenchmarkCorpus(CORPUS_CHARS);
+    HKL layout = GetKeyboardLayout(0);
+    ULONGLONG checksum = 0;  // Keeps the work observable
+
+    // Baseline: what the planner did per character before layout tables
+    double bestUncachedMs = BestRunMs(ITERATIONS, [&](int) {
+        for (wchar_t ch : corpus) {
+            inject::VKMapping mapping = inject::MapCharacterToVKUncached(ch, layout);
+            checksum += mapping.scancode;
+            if (mapping.needsShift) {
+                checksum += MapVirtualKeyW(VK_SHIFT, MAPVK_VK_TO_VSC);
+                checksum += MapVirtualKeyW(VK_SHIFT, MAPVK_VK_TO_VSC);
+            }
+        }
+    });
+
+    // Cold table: first paste into a layout pays for filling the entries it uses
+    double bestColdMs = BestRunMs(ITERATIONS, [&](int) {
+        inject::LayoutKeyTable& keys = inject::GetLayoutKeyTable(layout);
+        for (wchar_t ch : corpus) {
+            checksum += inject::LookupKey(keys, ch).scancode;
+        }
+    }, [](int) { inject::ClearLayoutKeyTables(); });
+
+    // Warm table: every later paste is a single array lookup per character
+    inject::LayoutKeyTable& keys = inject::GetLayoutKeyTable(layout);
+    double bestWarmMs = BestRunMs(ITERATIONS, [&](int) {
+        for (wchar_t ch : corpus) {
+            const inject::KeyMapEntry& key = inject::LookupKey(keys, ch);
+            checksum += key.scancode;
+            if (key.modifiers) checksum += keys.shiftScancode;
+        }
+    });
+
+    BenchmarkReport report(L"key mapping");
+    report.Add(L"Corpus: %zu chars, best of %d runs\r\n\r\n", corpus.size(), ITERATIONS);
+    report.Add(L"VkKeyScanExW per char: %8.3f ms (%6.1f Mchars/s)\r\n",
+        bestUncachedMs, corpus.size() / bestUncachedMs / 1000.0);
+    report.Add(L"Layout table (cold):   %8.3f ms (%6.1f Mchars/s)\r\n",
+        bestColdMs, corpus.size() / bestColdMs / 1000.0);
+    report.Add(L"Layout table (warm):   %8.3f ms (%6.1f Mchars/s)\r\n",
+        bestWarmMs, corpus.size() / bestWarmMs / 1000.0);
+    report.Add(L"Speedup (warm): %.1fx   [checksum %llu]\r\n",
+        bestUncachedMs / bestWarmMs, checksum);
+
+    ReportBenchmark(report);
+}
+
+// Shift coalescing: events per payload with and without holding Shift across runs
+void BenchmarkShiftCoalescing() {
+    struct Payload {
+        const wchar_t* name;
+        const wchar_t* text;
+    };
+    const Payload payloads[] = {
+        {L"PowerShell",
+         L"$ErrorActionPreference = 'Stop'\r\n"
+         L"Get-ChildItem -Path C:\\Logs -Filter *.log | Where-Object { $_.Length -gt 1MB } |\r\n"
+         L"    Sort-Object LastWriteTime -Descending | Select-Object -First 20 FullName, Length\r\n"
+         L"Set-ItemProperty -Path HKLM:\\SOFTWARE\\Contoso -Name MAX_RETRY_COUNT -Value 5\r\n"},
+        {L"YAML",
+         L"apiVersion: apps/v1\r\n"
+         L"kind: Deployment\r\n"
+         L"metadata:\r\n"
+         L"  name: web-frontend\r\n"
+         L"  labels: {app: \"web\", tier: \"frontend\"}\r\n"
+         L"spec:\r\n"
+         L"  env:\r\n"
+         L"    - name: LOG_LEVEL\r\n"
+         L"      value: \"INFO\"\r\n"},
+        {L"base64",
+         L"U2FsdGVkX1+vupppZksvRf5pq5g5XjFRIipRkwB0K1Y96Qsv2Lm+31cmzaAILwyt\r\n"
+         L"QUJDREVGR0hJSktMTU5PUFFSU1RVVldYWVphYmNkZWZnaGlqa2xtbm9wcXJzdHV2\r\n"
+         L"d3h5ejAxMjM0NTY3ODkrL0FCQ0RFRkdISUpLTE1OT1BRUlNUVVZXWFlaYWJjZGVm\r\n"},
+        {L"C constants",
+         L"#define MAX_PATH_LENGTH 260\r\n"
+         L"#define DEFAULT_TIMEOUT_MS 5000\r\n"
+         L"static const char* LOG_PREFIX = \"[MADPASTER] \";\r\n"},
+    };
+    const size_t REPEAT_CHARS = 20000;
+
+    HKL layout = GetKeyboardLayout(0);
+    inject::LayoutKeyTable& keys = inject::GetLayoutKeyTable(layout);
+    inject::PacingConfig config = inject::GetDefaultPacingConfig(TargetClass::Local);
+    inject::KeystrokePlan plan = {};
+
+    BenchmarkReport report(L"Shift coalescing (VK scancode mode)");
+    report.Add(L"Each payload repeated to ~%zu chars; pacing time at %d ms per event\r\n\r\n",
+        REPEAT_CHARS, PER_EVENT_DELAY_MS);
+
+    for (const Payload& payload : payloads) {
+        std::wstring text;
+        while (text.size() < REPEAT_CHARS) text += payload.text;
+
+        // Previous planner: Shift down/up around every shifted character
+        size_t legacyEvents = 0;
+        for (size_t i = 0; i < text.size(); i++) {
+            wchar_t c = text[i];
+            if (c == L'\r' && i + 1 < text.size() && text[i + 1] == L'\n') i++;
+            if (c == L'\r' || c == L'\n') {
+                legacyEvents += 2;
+                continue;
+            }
+            const inject::KeyMapEntry& key = inject::LookupKey(keys, c);
+            legacyEvents += (key.state == inject::KEYMAP_MAPPABLE && key.modifiers) ? 4 : 2;
+        }
+
+        inject::BuildKeystrokePlan(plan, text, InjectionMode::VKScancode, layout,
+                                   TargetClass::Local, config);
+        size_t events = plan.ops.size();
+
+        report.Add(L"%-12s %6zu -> %6zu events (-%4.1f%%), %6.1f s -> %6.1f s per-event\r\n",
+            payload.name, legacyEvents, events,
+            legacyEvents ? 100.0 * (legacyEvents - events) / legacyEvents : 0.0,
+            legacyEvents * PER_EVENT_DELAY_MS / 1000.0, events * PER_EVENT_DELAY_MS / 1000.0);
+    }
+
+    ReportBenchmark(report);
+}
+
+// Scheduled pacing time for a plan (no sleeping) - mirrors ApplyPace
+double EstimatePacingMs(const inject::KeystrokePlan& plan, const inject::PacingConfig& config) {
+    const double drainMs = 5 * 2.0;  // DrainInputQueue
+    double newlinePauseMs = config.baseKeystrokeDelayMs + config.newlinePauseMs / 2;
+    double total = 0.0;
+
+    for (const inject::KeyOp& op : plan.ops) {
+        switch (op.pace) {
+            case inject::PaceClass::None:
+                break;
+            case inject::PaceClass::Event:
+                total += config.perEventDelayMs;
+                break;
+            case inject::PaceClass::NewlinePre:
+            case inject::PaceClass::NewlinePost:
+                total += newlinePauseMs + drainMs;
+                break;
+            case inject::PaceClass::NewlineBoth:
+                total += 2 * newlinePauseMs + drainMs;
+                break;
+            case inject::PaceClass::Line:
+                total += config.baseKeystrokeDelayMs + LINE_BURST_PAUSE_MS;
+                break;
+            default:
+                total += inject::CharPauseMs(op, config, nullptr, 0);
+                if (config.strategy == PacingStrategy::Burst) total += drainMs;
+                break;
+        }
+    }
+    return total;
+}
+
+// Per-character-class pacing: uniform PER_CHAR_DELAY_MS vs class rules on mixed code
+void BenchmarkClassPacing() {
+    const size_t CORPUS_CHARS = 20000;
+
+    std::wstring corpus = BuildBenchmarkCorpus(CORPUS_CHARS);
+    HKL layout = GetKeyboardLayout(0);
+
+    inject::PacingConfig uniform = inject::GetDefaultPacingConfig(TargetClass::Citrix);
+    uniform.strategy = PacingStrategy::PerCharacter;
+    uniform.rules.plainMs = PER_CHAR_DELAY_MS;
+    uniform.rules.shiftedSymbolMs = PER_CHAR_DELAY_MS;
+    uniform.rules.unicodeMs = PER_CHAR_DELAY_MS;
+    uniform.rules.repeatMs = PER_CHAR_DELAY_MS;
+
+    inject::PacingConfig classed = inject::GetDefaultPacingConfig(TargetClass::Citrix);
+    classed.strategy = PacingStrategy::PerCharacter;
+
+    inject::KeystrokePlan plan = {};
+    inject::BuildKeystrokePlan(plan, corpus, InjectionMode::Hybrid, layout,
+                               TargetClass::Citrix, classed);
+
+    size_t counts[4] = {};
+    size_t lineStarts = 0;
+    for (const inject::KeyOp& op : plan.ops) {
+        switch (op.pace) {
+            case inject::PaceClass::Char:              counts[0]++; break;
+            case inject::PaceClass::CharShiftedSymbol: counts[1]++; break;
+            case inject::PaceClass::CharUnicode:       counts[2]++; break;
+            case inject::PaceClass::CharRepeat:        counts[3]++; break;
+            default: break;
+        }
+        if (op.flags & inject::KOP_LINE_START) lineStarts++;
+    }
+
+    double uniformMs = EstimatePacingMs(plan, uniform);
+    double classedMs = EstimatePacingMs(plan, classed);
+
+    BenchmarkReport report(L"per-character-class pacing");
+    report.Add(L"Corpus: %zu chars of mixed code, PerCharacter strategy, %d ms keystroke delay\r\n",
+        corpus.size(), classed.baseKeystrokeDelayMs);
+    report.Add(L"Times are estimates summed from the plan's pacing, not measured\r\n");
+    report.Add(L"Classes: %zu plain, %zu shifted symbol, %zu unicode, %zu repeat, %zu line-start\r\n\r\n",
+        counts[0], counts[1], counts[2], counts[3], lineStarts);
+    report.Add(L"Uniform %d ms/char: est. %8.1f s pacing (%6.1f chars/s)\r\n",
+        PER_CHAR_DELAY_MS, uniformMs / 1000.0, corpus.size() * 1000.0 / uniformMs);
+    report.Add(L"Class rules:       est. %8.1f s pacing (%6.1f chars/s)\r\n",
+        classedMs / 1000.0, corpus.size() * 1000.0 / classedMs);
+    report.Add(L"Estimated speedup: %.2fx\r\n", uniformMs / classedMs);
+
+    ReportBenchmark(report);
+}
+
+// Paste job used by the local paste benchmark
+struct BenchPasteRun {
+    std::wstring text;
+    TextStream stream;
+    inject::PacingConfig config;
+    inject::DiagnosticState diag;
+    inject::PasteChannel channel;
+    size_t charsSent;
+};
+
+DWORD WINAPI BenchPasteProc(LPVOID param) {
+    BenchPasteRun* run = static_cast<BenchPasteRun*>(param);
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_ABOVE_NORMAL);
+    run->stream.source.text = run->text;
+    run->charsSent = sendStreamToWindow(run->stream, InjectionMode::Auto, run->config,
+                                        inject::DetectRemoteClient(), &run->diag, &run->channel);
+    return 0;
+}
+
+// Paste text into the benchmark edit window on a worker while this thread
+// pumps the window's messages. Returns elapsed ms until the edit has caught up.
+double TimeLocalPaste(HWND hwndEdit, BenchPasteRun& run, size_t& received) {
+    SetWindowTextW(hwndEdit, L"");
+    SetForegroundWindow(hwndEdit);
+    SetFocus(hwndEdit);
+
+    LONGLONG start = inject::QpcNow();
+    HANDLE hThread = CreateThread(nullptr, 0, BenchPasteProc, &run, 0, nullptr);
+    if (!hThread) {
+        received = 0;
+        return 0.0;
+    }
+
+    MSG msg;
+    LONGLONG lastMessage = inject::QpcNow();
+    bool workerDone = false;
+    for (;;) {
+        DWORD wait = MsgWaitForMultipleObjects(workerDone ? 0 : 1, &hThread, FALSE,
+                                               workerDone ? 20 : INFINITE, QS_ALLINPUT);
+        if (wait == WAIT_OBJECT_0 && !workerDone) {
+            workerDone = true;
+            continue;
+        }
+        bool pumped = false;
+        while (PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE)) {
+            TranslateMessage(&msg);
+            DispatchMessageW(&msg);
+            pumped = true;
+        }
+        if (pumped) lastMessage = inject::QpcNow();
+
+        // Worker finished and the queue has been quiet for a moment - input is all in
+        if (workerDone && wait == WAIT_TIMEOUT) break;
+    }
+
+    CloseHandle(hThread);
+    received = static_cast<size_t>(GetWindowTextLengthW(hwndEdit));
+    return inject::QpcToMs(lastMessage - start);
+}
+
+// Local paste throughput: legacy 2-char Burst vs line-burst into a real EDIT control
+void BenchmarkLocalPaste() {
+    const size_t BURST_SIZES[] = {1000, 4000};
+    const size_t LINE_BURST_SIZES[] = {1000, 4000, 16000, 45000};
+
+    HWND hwndEdit = CreateWindowExW(WS_EX_TOPMOST, L"EDIT", L"MadPaster Benchmark",
+        WS_OVERLAPPEDWINDOW | WS_VISIBLE | WS_VSCROLL | ES_MULTILINE | ES_AUTOVSCROLL | ES_WANTRETURN,
+        CW_USEDEFAULT, CW_USEDEFAULT, 640, 480, nullptr, nullptr, GetModuleHandleW(nullptr), nullptr);
+    BenchmarkReport report(L"local paste into EDIT control");
+    if (!hwndEdit) {
+        report.Add(L"Failed to create edit window\r\n");
+        ReportBenchmark(report);
+        return;
+    }
+    SendMessageW(hwndEdit, EM_SETLIMITTEXT, 0, 0);
+    report.Add(L"Do not type while the benchmark runs\r\n\r\n");
+
+    struct Series {
+        const wchar_t* name;
+        PacingStrategy strategy;
+        const size_t* sizes;
+        size_t count;
+    };
+    const Series series[] = {
+        {L"Burst (2 chars)", PacingStrategy::Burst, BURST_SIZES, _countof(BURST_SIZES)},
+        {L"Line burst", PacingStrategy::LineBurst, LINE_BURST_SIZES, _countof(LINE_BURST_SIZES)},
+    };
+
+    for (const Series& entry : series) {
+        for (size_t i = 0; i < entry.count; i++) {
+            BenchPasteRun run;
+            run.text = BuildBenchmarkCorpus(entry.sizes[i]);
+            run.config = inject::GetDefaultPacingConfig(TargetClass::Local);
+            run.config.strategy = entry.strategy;
+            run.channel = {};
+            run.charsSent = 0;
+
+            size_t received = 0;
+            double ms = TimeLocalPaste(hwndEdit, run, received);
+            report.Add(L"%-16s %6zu chars: %9.0f ms (%8.1f chars/s), edit has %zu%s\r\n",
+                entry.name, run.text.size(), ms, ms > 0.0 ? run.text.size() * 1000.0 / ms : 0.0,
+                received, received == run.text.size() ? L"" : L" (MISMATCH)");
+        }
+    }
+
+    DestroyWindow(hwndEdit);
+    ReportBenchmark(report);
+}
+
+// Decoding throughput: the Win32 path (MultiByteToWideChar sized, then
+// converted; scalar byte swap for UTF-16 BE) vs textdecode at each SIMD level
+void BenchmarkDecoding() {
+    const size_t CORPUS_CHARS = 4 * 1024 * 1024;
+    const int ITERATIONS = 10;
+
+    // Mixed code with a few non-ASCII characters, and the same text as pure ASCII
+    std::wstring mixed = BuildBenchmarkCorpus(CORPUS_CHARS);
+    std::wstring ascii = BuildAsciiBenchmarkCorpus(CORPUS_CHARS);
+
+    struct Input {
+        const wchar_t* name;
+        std::string bytes;
+        bool utf16;
+    };
+    const Input inputs[] = {
+        {L"UTF-8 mixed", EncodeBenchmarkText(mixed, false), false},
+        {L"UTF-8 ASCII", EncodeBenchmarkText(ascii, false), false},
+        {L"UTF-16 BE", EncodeBenchmarkText(mixed, true), true},
+    };
+
+    BenchmarkReport report(L"decoding");
+    report.Add(L"Corpus: %zu chars, best of %d runs, CPU supports %hs\r\n\r\n",
+        mixed.size(), ITERATIONS, textdecode::SimdLevelName(textdecode::BestSimdLevel()));
+
+    for (const Input& input : inputs) {
+        const unsigned char* data = reinterpret_cast<const unsigned char*>(input.bytes.data());
+        size_t size = input.bytes.size();
+        double megabytes = size / (1024.0 * 1024.0);
+
+        // Win32 path, as files were decoded before
+        std::wstring expected;
+        double bestWin32Ms = BestRunMs(ITERATIONS, [&](int) {
+            std::wstring decoded;
+            if (input.utf16) {
+                decoded.resize(size / 2);
+                for (size_t i = 0; i < decoded.size(); ++i) {
+                    decoded[i] = static_cast<wchar_t>((data[i * 2] << 8) | data[i * 2 + 1]);
+                }
+            } else {
+                appendWide(CP_UTF8, data, size, decoded);
+            }
+            expected.swap(decoded);
+        });
+        report.Add(L"%-12s Win32   %8.2f ms (%7.1f MB/s)\r\n",
+            input.name, bestWin32Ms, megabytes / (bestWin32Ms / 1000.0));
+
+        const textdecode::SimdLevel levels[] = {
+            textdecode::SimdLevel::Scalar, textdecode::SimdLevel::Sse2, textdecode::SimdLevel::Avx2
+        };
+        for (textdecode::SimdLevel level : levels) {
+            if (!textdecode::IsSimdLevelSupported(level)) continue;
+
+            std::wstring decoded(size, L'\0');
+            size_t units = 0;
+            bool valid = true;
+            double bestMs = BestRunMs(ITERATIONS, [&](int) {
+                units = input.utf16
+                    ? textdecode::DecodeUtf16(data, size, true, &decoded[0], level)
+                    : textdecode::DecodeUtf8(data, size, &decoded[0], valid, level);
+            });
+            bool matches = (units == expected.size() &&
+                            std::equal(expected.begin(), expected.end(), decoded.begin()));
+            report.Add(L"%-12s %-7hs %8.2f ms (%7.1f MB/s) %5.1fx%s\r\n",
+                input.name, textdecode::SimdLevelName(level), bestMs, megabytes / (bestMs / 1000.0),
+                bestWin32Ms / bestMs, matches && valid ? L"" : L" (MISMATCH)");
+        }
+        report.Add(L"\r\n");
+    }
+
+    ReportBenchmark(report);
+}
+
+// Peak working set of this process so far
+SIZE_T PeakWorkingSetBytes() {
+    PROCESS_MEMORY_COUNTERS counters = {};
+    counters.cb = sizeof(counters);
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.PeakWorkingSetSize;
+}
+
+// Write the benchmark sample repeatedly to a temp file, a block at a time so
+// building it doesn't raise the peak working set. Returns the path (empty on failure).
+std::wstring WriteBenchmarkFile(size_t bytes, bool utf16BigEndian) {
+    wchar_t tempDir[MAX_PATH];
+    wchar_t tempPath[MAX_PATH];
+    if (!GetTempPathW(MAX_PATH, tempDir) ||
+        !GetTempFileNameW(tempDir, L"mad", 0, tempPath)) {
+        return L"";
+    }
+
+    HANDLE hFile = CreateFileW(tempPath, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                               FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE) return L"";
+
+    // One encoded copy of the sample, repeated
+    std::string sample = EncodeBenchmarkText(BENCH_SAMPLE, utf16BigEndian);
+
+    std::string block = utf16BigEndian ? std::string("\xFE\xFF") : std::string();
+    size_t written = 0;
+    bool success = true;
+    while (success && written < bytes) {
+        while (block.size() < 64 * 1024) block += sample;
+        DWORD chunk = static_cast<DWORD>((std::min)(block.size(), bytes - written));
+        DWORD done = 0;
+        success = WriteFile(hFile, block.data(), chunk, &done, nullptr) && done == chunk;
+        written += chunk;
+        block.clear();
+    }
+    CloseHandle(hFile);
+
+    if (!success) {
+        DeleteFileW(tempPath);
+        return L"";
+    }
+    return tempPath;
+}
+
+// How files were read before streaming: the whole file into one buffer, then
+// converted into a second, full-size string
+bool ReadWholeFileForBenchmark(const std::wstring& path, std::wstring& text) {
+    HANDLE hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(hFile, &fileSize);
+    std::vector<unsigned char> buffer(static_cast<size_t>(fileSize.QuadPart));
+    DWORD bytesRead = 0;
+    bool success = ReadFile(hFile, buffer.data(), static_cast<DWORD>(buffer.size()), &bytesRead, nullptr) != 0;
+    CloseHandle(hFile);
+    if (!success) return false;
+
+    text.clear();
+    if (textdecode::DetectEncoding(buffer.data(), bytesRead).encoding == textdecode::Encoding::Utf16BE) {
+        text.resize((bytesRead - 2) / 2);
+        for (size_t i = 0; i < text.size(); ++i) {
+            text[i] = static_cast<wchar_t>((buffer[2 + i * 2] << 8) | buffer[3 + i * 2]);
+        }
+    } else {
+        appendWide(CP_UTF8, buffer.data(), bytesRead, text);
+    }
+    return true;
+}
+
+// The per-character switch NormalizeSmartCharacters used before the table
+// (always copies; covers six code points). Benchmark baseline only.
+std::wstring LegacyNormalizeForBenchmark(std::wstring_view input) {
+    std::wstring result;
+    result.reserve(input.size());
+    for (wchar_t c : input) {
+        switch (c) {
+            case L'\u2018': case L'\u2019': result += L'\''; break;
+            case L'\u201C': case L'\u201D': result += L'"'; break;
+            case L'\u2013': case L'\u2014': result += L'-'; break;
+            case L'\u2026': result += L"..."; break;
+            default: result += c; break;
+        }
+    }
+    return result;
+}
+
+// Normalization throughput on 4M characters, block by block as the stream
+// reader does it: the old switch vs the table with the ASCII skip. Prose only
+// uses characters both handle, so their output must match.
+void BenchmarkNormalization() {
+    const size_t CORPUS_CHARS = 4 * 1024 * 1024;
+    const int ITERATIONS = 10;
+
+    std::wstring code = BuildBenchmarkCorpus(CORPUS_CHARS);
+    std::wstring ascii = BuildAsciiBenchmarkCorpus(CORPUS_CHARS);
+    std::wstring prose;
+    prose.reserve(CORPUS_CHARS);
+    const wchar_t* sentence =
+        L"\u201CDon\u2019t restart the service\u201D \u2013 the docs say it\u2019s safe\u2026 "
+        L"but the 09:00\u201410:00 window is \u2018frozen\u2019.\r\n";
+    while (prose.size() < CORPUS_CHARS) prose += sentence;
+
+    struct Input {
+        const wchar_t* name;
+        const std::wstring* text;
+    };
+    const Input inputs[] = {
+        {L"Code", &code},
+        {L"ASCII", &ascii},
+        {L"Prose", &prose},
+    };
+
+    BenchmarkReport report(L"normalization");
+    report.Add(L"Corpus: %zu chars in %zu-char blocks, best of %d runs, CPU supports %hs\r\n\r\n",
+        code.size(), STREAM_TEXT_BLOCK, ITERATIONS,
+        textdecode::SimdLevelName(textdecode::BestSimdLevel()));
+
+    for (const Input& input : inputs) {
+        std::wstring_view text(*input.text);
+        size_t blocks = (text.size() + STREAM_TEXT_BLOCK - 1) / STREAM_TEXT_BLOCK;
+        ULONGLONG checksum = 0;  // Keeps the work observable
+
+        // The warm-up run (run 0) hashes the output and counts uncopied blocks
+        ULONGLONG legacyHash = inject::TEXT_HASH_SEED;
+        double bestLegacyMs = BestRunMs(ITERATIONS, [&](int run) {
+            for (size_t offset = 0; offset < text.size(); offset += STREAM_TEXT_BLOCK) {
+                std::wstring block = LegacyNormalizeForBenchmark(text.substr(offset, STREAM_TEXT_BLOCK));
+                checksum += block.size();
+                if (run == 0) legacyHash = inject::HashText(block.data(), block.size(), legacyHash);
+            }
+        });
+
+        ULONGLONG tableHash = inject::TEXT_HASH_SEED;
+        size_t unchanged = 0;
+        std::wstring scratch;
+        double bestTableMs = BestRunMs(ITERATIONS, [&](int run) {
+            for (size_t offset = 0; offset < text.size(); offset += STREAM_TEXT_BLOCK) {
+                std::wstring_view block = text.substr(offset, STREAM_TEXT_BLOCK);
+                std::wstring_view normalized = textnormalize::NormalizeSmartCharacters(block, scratch);
+                checksum += normalized.size();
+                if (run == 0) {
+                    tableHash = inject::HashText(normalized.data(), normalized.size(), tableHash);
+                    if (normalized.data() == block.data()) unchanged++;
+                }
+            }
+        });
+
+        report.Add(L"%-6s switch %8.2f ms (%7.1f Mchars/s)\r\n",
+            input.name, bestLegacyMs, text.size() / bestLegacyMs / 1000.0);
+        report.Add(L"%-6s table  %8.2f ms (%7.1f Mchars/s) %5.1fx, %zu of %zu blocks not copied%s\r\n",
+            input.name, bestTableMs, text.size() / bestTableMs / 1000.0, bestLegacyMs / bestTableMs,
+            unchanged, blocks, legacyHash == tableHash ? L"" : L" (MISMATCH)");
+        report.Add(L"       [checksum %llu]\r\n\r\n", checksum);
+    }
+
+    ReportBenchmark(report);
+}
+
+// File ingestion: mapped views decoded incrementally vs the old whole-file read,
+// with the peak working set each one adds. Peaks only grow, so the mapped reads
+// run first; the whole-file reads then show what the old path needed on top.
+void BenchmarkFileIngestion() {
+    const size_t FILE_BYTES = 32 * 1024 * 1024;
+
+    struct Input {
+        const wchar_t* name;
+        bool utf16BigEndian;
+        std::wstring path;
+    };
+    Input inputs[] = {
+        {L"UTF-8", false, L""},
+        {L"UTF-16 BE", true, L""},
+    };
+    for (Input& input : inputs) {
+        input.path = WriteBenchmarkFile(FILE_BYTES, input.utf16BigEndian);
+        if (input.path.empty()) {
+            BenchmarkReport failed(L"file ingestion");
+            failed.Add(L"Failed to write temp file\r\n");
+            ReportBenchmark(failed);
+            for (Input& written : inputs) {
+                if (!written.path.empty()) DeleteFileW(written.path.c_str());
+            }
+            return;
+        }
+    }
+
+    BenchmarkReport report(L"file ingestion");
+    report.Add(L"Files: %zu MB each, mapped in %zu KB views\r\n",
+        FILE_BYTES / (1024 * 1024), FILE_VIEW_BYTES / 1024);
+    report.Add(L"Peak working set before: %.1f MB\r\n\r\n", PeakWorkingSetBytes() / (1024.0 * 1024.0));
+
+    // Mapped views, decoded one view at a time
+    for (const Input& input : inputs) {
+        SIZE_T peakBefore = PeakWorkingSetBytes();
+        ULONGLONG checksum = 0;
+        size_t units = 0;
+        std::wstring error;
+        LONGLONG start = inject::QpcNow();
+        readFileBlocks(input.path, [&](std::wstring_view block) {
+            units += block.size();
+            checksum += block.back();
+            return true;
+        }, error);
+        double ms = inject::QpcToMs(inject::QpcNow() - start);
+        report.Add(L"Mapped     %-9s %9zu units %8.1f ms (%7.1f MB/s), peak +%6.1f MB   [%llu]\r\n",
+            input.name, units, ms, FILE_BYTES / (1024.0 * 1024.0) / (ms / 1000.0),
+            (PeakWorkingSetBytes() - peakBefore) / (1024.0 * 1024.0), checksum);
+    }
+
+    // Whole-file read and convert
+    for (const Input& input : inputs) {
+        SIZE_T peakBefore = PeakWorkingSetBytes();
+        std::wstring text;
+        LONGLONG start = inject::QpcNow();
+        ReadWholeFileForBenchmark(input.path, text);
+        double ms = inject::QpcToMs(inject::QpcNow() - start);
+        report.Add(L"Whole file %-9s %9zu units %8.1f ms (%7.1f MB/s), peak +%6.1f MB\r\n",
+            input.name, text.size(), ms, FILE_BYTES / (1024.0 * 1024.0) / (ms / 1000.0),
+            (PeakWorkingSetBytes() - peakBefore) / (1024.0 * 1024.0));
+    }
+
+    report.Add(L"\r\nPeak working set after: %.1f MB\r\n", PeakWorkingSetBytes() / (1024.0 * 1024.0));
+
+    for (const Input& input : inputs) DeleteFileW(input.path.c_str());
+    ReportBenchmark(report);
+}
+
+// Clipboard-style paste through the whole pipeline up to the keystroke plans
+// (source, normalization, ring, line chunks, planner), without injecting.
+// The peak working set shows what the pipeline needs on top of the text itself.
+void BenchmarkPipeline() {
+    const size_t CORPUS_CHARS = 16 * 1024 * 1024;
+
+    TextStream stream;
+    stream.source.text = BuildBenchmarkCorpus(CORPUS_CHARS);
+    double textMegabytes = stream.source.text.size() * sizeof(wchar_t) / (1024.0 * 1024.0);
+
+    HKL layout = GetKeyboardLayout(0);
+    inject::PacingConfig config = inject::GetDefaultPacingConfig(TargetClass::Rdp);
+    inject::KeystrokePlan plan = {};
+    ChunkBuffer chunkBuffer;
+    std::wstring_view chunk;
+    size_t chunks = 0;
+    size_t units = 0;
+    size_t ops = 0;
+
+    SIZE_T peakBefore = PeakWorkingSetBytes();
+    LONGLONG start = inject::QpcNow();
+    bool started = StartTextStream(stream);
+    while (started && ReadStreamChunk(stream, chunkBuffer, chunk)) {
+        inject::BuildKeystrokePlan(plan, chunk, InjectionMode::Hybrid, layout, TargetClass::Rdp, config);
+        chunks++;
+        units += chunk.size();
+        ops += plan.ops.size();
+    }
+    StopTextStream(stream);
+    double ms = inject::QpcToMs(inject::QpcNow() - start);
+
+    BenchmarkReport report(L"pipeline");
+    report.Add(L"Text: %zu chars (%.1f MB), Hybrid plans for an RDP target\r\n\r\n",
+        stream.source.text.size(), textMegabytes);
+    report.Add(L"Planned %zu chars in %zu chunks (%zu ops) in %.1f ms (%.1f Mchars/s)\r\n",
+        units, chunks, ops, ms, units / ms / 1000.0);
+    report.Add(L"Peak working set: +%.1f MB over the text's %.1f MB%s\r\n",
+        (PeakWorkingSetBytes() - peakBefore) / (1024.0 * 1024.0), textMegabytes,
+        units == stream.totalUnits ? L"" : L" (LENGTH MISMATCH)");
+
+    ReportBenchmark(report);
+}
+
+// Run the benchmark named on the command line
+// Returns false if the name is unknown
+bool RunBenchmark(const std::wstring& name) {
+    if (_wcsicmp(name.c_str(), L"mapping") == 0) {
+        BenchmarkKeyMapping();
+        return true;
+    }
+    if (_wcsicmp(name.c_str(), L"shift") == 0) {
+        BenchmarkShiftCoalescing();
+        return true;
+    }
+    if (_wcsicmp(name.c_str(), L"classes") == 0) {
+        BenchmarkClassPacing();
+        return true;
+    }
+    if (_wcsicmp(name.c_str(), L"local") == 0) {
+        BenchmarkLocalPaste();
+        return true;
+    }
+    if (_wcsicmp(name.c_str(), L"decode") == 0) {
+        BenchmarkDecoding();
+        return true;
+    }
+    if (_wcsicmp(name.c_str(), L"normalize") == 0) {
+        BenchmarkNormalization();
+        return true;
+    }
+    if (_wcsicmp(name.c_str(), L"ingest") == 0) {
+        BenchmarkFileIngestion();
+        return true;
+    }
+    if (_wcsicmp(name.c_str(), L"pipeline") == 0) {
+        BenchmarkPipeline();
+        return true;
+    }
+    return false;
+}
+
 // ============================================================================
 // Command Line Parsing
 // ============================================================================
 
 // Parse command line arguments
-// Supports: --diag, --mode=vk|hybrid|unicode|auto
+// Supports: --diag, --mode=vk|hybrid|unicode|auto, --bench=mapping|shift|classes|local|decode|normalize|ingest|pipeline
 void ParseCommandLine() {
     int argc = 0;
     LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
@@ -2338,6 +6075,12 @@ void ParseCommandLine() {
             g_app.injectionMode = ParseInjectionMode(modeStr);
             continue;
         }
+
+        // --bench=name (run a benchmark, report it and exit)
+        if (_wcsnicmp(argv[i], L"--bench=", 8) == 0) {
+            g_app.benchmarkName = argv[i] + 8;
+            continue;
+        }
     }
 
     LocalFree(argv);
@@ -2366,6 +6109,16 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
     // Parse command line (overrides INI settings)
     ParseCommandLine();
 
+    // Benchmark mode reports through the diagnostic log and exits without a window
+    if (!g_app.benchmarkName.empty()) {
+        if (!RunBenchmark(g_app.benchmarkName)) {
+            std::wstring msg = L"Unknown benchmark: " + g_app.benchmarkName;
+            MessageBoxW(NULL, msg.c_str(), L"MadPaster - Error", MB_OK | MB_ICONERROR);
+            return 1;
+        }
+        return 0;
+    }
+
     // Initialize GDI+
     GdiplusStartupInput gdiplusStartupInput;
     GdiplusStartup(&g_app.gdiplusToken, &gdiplusStartupInput, NULL);
@@ -0,0 +1,128 @@
+/*
+ * MadPaster - Portable paste plan core
+ *
+ * The compact keystroke ops a paste is compiled into, the resumable cursor
+ * the executor and an interrupted paste seek through them with, and where the
+ * streaming pipeline cuts pending text into chunks. No Win32 dependency, so
+ * it builds and runs on Linux as well; Unit is wchar_t on Windows, char16_t
+ * elsewhere.
+ */
+
+#ifndef MADPASTER_PASTEPLAN_H
+#define MADPASTER_PASTEPLAN_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace inject {
+
+// ============================================================================
+// Keystroke Ops
+// ============================================================================
+
+// KeyOp flags
+const uint8_t KOP_KEYUP    = 0x01;  // Key release (otherwise key press)
+const uint8_t KOP_UNICODE  = 0x02;  // code is a UTF-16 unit (otherwise a scancode)
+const uint8_t KOP_CHAR_END = 0x04;  // Source character complete (a held Shift may follow later)
+const uint8_t KOP_PAIR     = 0x08;  // Character end consumed two units (CR+LF or a surrogate pair)
+const uint8_t KOP_LINE_END = 0x10;  // Enter key release
+const uint8_t KOP_LINE_START = 0x20; // Character boundary inside the line-start guard
+const uint8_t KOP_SHIFT    = 0x40;  // Shift key event (tracked so a focus pause can release it)
+
+// Pause the executor applies after an op (batches are flushed at any non-None class)
+enum class PaceClass : uint8_t {
+    None,         // Batched with the following op
+    Event,        // Between events of one character (PerEvent strategy)
+    Char,         // Character/chunk boundary (plain character)
+    CharShiftedSymbol, // Character boundary after a symbol that needs Shift
+    CharUnicode,  // Character boundary after an unmappable Unicode fallback
+    CharRepeat,   // Character boundary after a repeat of the previous character
+    NewlinePre,   // Before an Enter key
+    NewlinePost,  // After an Enter key
+    NewlineBoth,  // After an Enter key that is followed by another Enter
+    Line          // End of a line (LineBurst strategy)
+};
+
+struct KeyOp {
+    uint16_t code;   // Scancode, or UTF-16 code unit with KOP_UNICODE
+    uint8_t flags;   // KOP_* bits
+    PaceClass pace;
+};
+static_assert(sizeof(KeyOp) == 4, "KeyOp must stay compact");
+
+// Source units a character end completes
+inline size_t CharEndUnits(const KeyOp& op) {
+    return (op.flags & KOP_PAIR) ? 2 : 1;
+}
+
+// ============================================================================
+// Injection Cursor
+// ============================================================================
+
+// Resumable position in a plan. Always sits on a batch boundary: everything
+// before op has been sent, nothing after it has. Pacing state is not part of
+// it: the scheduler and token bucket live for the whole paste, and a paste
+// resumed later starts after an idle gap in which the target has drained.
+struct InjectionCursor {
+    size_t op;          // Next op to send
+    size_t units;       // Source units completed (progress, resume offset)
+    size_t column;      // Characters typed on the current line
+    size_t lineStart;   // Units before the current source line (resume after a restart)
+    uint16_t heldShift; // Shift scancode held at the boundary (0 = released)
+};
+
+// Cursor for a source offset, replaying the modifier and column state up to it
+// Stops at the first character end at or past units; a CR+LF or surrogate pair
+// is one character, so an offset inside one lands after it
+inline InjectionCursor SeekOps(const KeyOp* ops, size_t count, size_t startColumn,
+                               size_t units) {
+    InjectionCursor cursor = {};
+    cursor.column = startColumn;
+    while (cursor.op < count && cursor.units < units) {
+        const KeyOp& op = ops[cursor.op++];
+        if (op.flags & KOP_SHIFT) cursor.heldShift = (op.flags & KOP_KEYUP) ? 0 : op.code;
+        if (op.flags & KOP_CHAR_END) {
+            cursor.units += CharEndUnits(op);
+            cursor.column++;
+        }
+        if (op.flags & KOP_LINE_END) {
+            cursor.column = 0;
+            if (op.flags & KOP_CHAR_END) cursor.lineStart = cursor.units;
+        }
+    }
+    return cursor;
+}
+
+// ============================================================================
+// Stream Chunks
+// ============================================================================
+
+const size_t STREAM_CHUNK_UNITS = 4096;            // Planned at a time, cut after a line break
+const size_t STREAM_MAX_CHUNK_UNITS = 256 * 1024;  // Longer lines are cut mid-line
+
+// Where to cut pending text into a chunk (0 = read more first), after the
+// last line break once a chunk's worth is pending, mid-line only for very
+// long lines. CR, LF and CR+LF all end a line; the planner types each as Enter.
+template <typename Unit>
+size_t FindChunkCut(const Unit* pending, size_t length, bool ended) {
+    if (ended) return length;
+    if (length < STREAM_CHUNK_UNITS) return 0;
+
+    // A CR is only a whole line break when the next unit is already here
+    for (size_t i = length; i-- > 0;) {
+        if (pending[i] == Unit('\n') || (pending[i] == Unit('\r') && i + 1 < length)) {
+            return i + 1;
+        }
+    }
+    if (length < STREAM_MAX_CHUNK_UNITS) return 0;
+
+    // Never split a CR+LF or a surrogate pair
+    size_t cut = STREAM_MAX_CHUNK_UNITS;
+    uint32_t last = static_cast<uint32_t>(pending[cut - 1]);
+    if (last == '\r' || (last >= 0xD800 && last <= 0xDBFF)) cut--;
+    return cut;
+}
+
+} // namespace inject
+
+#endif // MADPASTER_PASTEPLAN_H
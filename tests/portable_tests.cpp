@@ -0,0 +1,456 @@
+/*
+ * MadPaster - Tests for the portable headers
+ *
+ * Decoding, normalization, stream chunk cuts and plan seeking, checked on
+ * char16_t text so they run on Linux as well as Windows. Exits non-zero if
+ * any check fails.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "textdecode.h"
+#include "textnormalize.h"
+#include "pasteplan.h"
+
+using inject::InjectionCursor;
+using inject::KeyOp;
+using textdecode::SimdLevel;
+
+static int g_checks = 0;
+static int g_failures = 0;
+
+#define CHECK(condition)                                                      \
+    do {                                                                      \
+        g_checks++;                                                           \
+        if (!(condition)) {                                                   \
+            g_failures++;                                                     \
+            std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+        }                                                                     \
+    } while (0)
+
+const SimdLevel ALL_LEVELS[] = {SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Avx2};
+
+// Bytes of a string literal (may hold NULs and invalid UTF-8)
+template <size_t N>
+std::string Bytes(const char (&literal)[N]) {
+    return std::string(literal, N - 1);
+}
+
+const unsigned char* Data(const std::string& bytes) {
+    return reinterpret_cast<const unsigned char*>(bytes.data());
+}
+
+// Mapping replacements are wchar_t; compare them with an ASCII expectation
+bool SameText(const wchar_t* text, const char* expected) {
+    if (!text) return false;
+    for (; *text && *expected; ++text, ++expected) {
+        if (*text != static_cast<wchar_t>(*expected)) return false;
+    }
+    return *text == 0 && *expected == 0;
+}
+
+// ============================================================================
+// textdecode.h
+// ============================================================================
+
+void TestDetectEncoding() {
+    using textdecode::Encoding;
+
+    std::string utf8Bom = Bytes("\xEF\xBB\xBFhi");
+    textdecode::Detection d = textdecode::DetectEncoding(Data(utf8Bom), utf8Bom.size());
+    CHECK(d.encoding == Encoding::Utf8 && d.bomBytes == 3);
+
+    std::string le = Bytes("\xFF\xFEh\0i\0");
+    d = textdecode::DetectEncoding(Data(le), le.size());
+    CHECK(d.encoding == Encoding::Utf16LE && d.bomBytes == 2);
+
+    std::string be = Bytes("\xFE\xFF\0h\0i");
+    d = textdecode::DetectEncoding(Data(be), be.size());
+    CHECK(d.encoding == Encoding::Utf16BE && d.bomBytes == 2);
+
+    std::string bomlessLe = Bytes("e\0c\0h\0o\0 \0o\0k\0");
+    d = textdecode::DetectEncoding(Data(bomlessLe), bomlessLe.size());
+    CHECK(d.encoding == Encoding::Utf16LE && d.bomBytes == 0);
+
+    std::string bomlessBe = Bytes("\0e\0c\0h\0o\0 \0o\0k");
+    d = textdecode::DetectEncoding(Data(bomlessBe), bomlessBe.size());
+    CHECK(d.encoding == Encoding::Utf16BE && d.bomBytes == 0);
+
+    std::string ascii = Bytes("echo ok");
+    d = textdecode::DetectEncoding(Data(ascii), ascii.size());
+    CHECK(d.encoding == Encoding::Unknown && d.bomBytes == 0);
+}
+
+void TestCompleteUtf8Length() {
+    std::string cut = Bytes("ab\xF0\x9F\x98");
+    CHECK(textdecode::CompleteUtf8Length(Data(cut), cut.size()) == 2);
+
+    std::string whole = Bytes("ab\xF0\x9F\x98\x80");
+    CHECK(textdecode::CompleteUtf8Length(Data(whole), whole.size()) == whole.size());
+
+    std::string twoByte = Bytes("a\xC3");
+    CHECK(textdecode::CompleteUtf8Length(Data(twoByte), twoByte.size()) == 1);
+}
+
+// Decode at every level the CPU supports; every level must agree
+bool DecodesUtf8To(const std::string& bytes, const std::u16string& expected, bool expectValid) {
+    bool ok = true;
+    for (SimdLevel level : ALL_LEVELS) {
+        if (!textdecode::IsSimdLevelSupported(level)) continue;
+        std::u16string out(bytes.size(), u'\0');
+        bool valid = true;
+        size_t units = textdecode::DecodeUtf8(Data(bytes), bytes.size(), &out[0], valid, level);
+        out.resize(units);
+        if (out != expected || valid != expectValid) {
+            std::printf("  DecodeUtf8 mismatch at %s\n", textdecode::SimdLevelName(level));
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+void TestDecodeUtf8() {
+    // Long enough ASCII runs for the vector paths on both sides of each sequence
+    std::string run(40, 'x');
+    std::u16string run16(40, u'x');
+
+    CHECK(DecodesUtf8To(run + Bytes("caf\xC3\xA9 \xE2\x80\x94 ") + run,
+                        run16 + u"caf\u00E9 \u2014 " + run16, true));
+    CHECK(DecodesUtf8To(run + Bytes("\xF0\x9F\x98\x80") + run,
+                        run16 + u"\U0001F600" + run16, true));
+
+    // Truncated 4-byte sequence: one U+FFFD for the whole maximal subpart
+    CHECK(DecodesUtf8To(Bytes("a\xF0\x9F\x98z"), u"a\uFFFDz", false));
+    // Overlong and surrogate encodings: one U+FFFD per byte
+    CHECK(DecodesUtf8To(Bytes("\xC0\xAF"), u"\uFFFD\uFFFD", false));
+    CHECK(DecodesUtf8To(Bytes("\xED\xA0\x80"), u"\uFFFD\uFFFD\uFFFD", false));
+    // Past U+10FFFF
+    CHECK(DecodesUtf8To(Bytes("\xF4\x90\x80\x80"), u"\uFFFD\uFFFD\uFFFD\uFFFD", false));
+    // Lone continuation byte inside an ASCII run
+    CHECK(DecodesUtf8To(run + Bytes("\x80") + run, run16 + u"\uFFFD" + run16, false));
+}
+
+void TestDecodeUtf16() {
+    std::u16string expected;
+    for (int i = 0; i < 50; i++) expected += static_cast<char16_t>(u'a' + i % 26);
+    expected += u"\u00E9\U0001F600";
+
+    std::string be;
+    std::string le;
+    for (char16_t unit : expected) {
+        be += static_cast<char>(unit >> 8);
+        be += static_cast<char>(unit & 0xFF);
+        le += static_cast<char>(unit & 0xFF);
+        le += static_cast<char>(unit >> 8);
+    }
+    be += 'Z';  // Trailing odd byte is ignored
+    le += 'Z';
+
+    for (SimdLevel level : ALL_LEVELS) {
+        if (!textdecode::IsSimdLevelSupported(level)) continue;
+        std::u16string out(be.size() / 2, u'\0');
+        CHECK(textdecode::DecodeUtf16(Data(be), be.size(), true, &out[0], level) == expected.size());
+        CHECK(out == expected);
+
+        out.assign(le.size() / 2, u'\0');
+        CHECK(textdecode::DecodeUtf16(Data(le), le.size(), false, &out[0], level) == expected.size());
+        CHECK(out == expected);
+    }
+}
+
+// Every length up to a few vectors, with the first non-ASCII unit at every position
+void TestAsciiPrefixLength() {
+    for (SimdLevel level : ALL_LEVELS) {
+        if (!textdecode::IsSimdLevelSupported(level)) continue;
+        bool ok = true;
+        for (size_t length = 0; length <= 70; length++) {
+            for (size_t stop = 0; stop <= length; stop++) {
+                std::u16string text(length, u'a');
+                if (stop < length) text[stop] = (stop % 2) ? u'\u00E9' : u'\u0080';
+                if (textdecode::AsciiPrefixLength(text.data(), text.size(), level) != stop) {
+                    std::printf("  AsciiPrefixLength %s: length %zu, stop %zu\n",
+                                textdecode::SimdLevelName(level), length, stop);
+                    ok = false;
+                }
+            }
+        }
+        CHECK(ok);
+    }
+}
+
+// ============================================================================
+// textnormalize.h
+// ============================================================================
+
+void TestNormalizeTable() {
+    using textnormalize::IsSmartSlot;
+    using textnormalize::NormalizeSlot;
+    using textnormalize::Transliteration;
+
+    CHECK(NormalizeSlot(u'a') == 0);
+    CHECK(NormalizeSlot(u'\u00E8') != 0 && !IsSmartSlot(NormalizeSlot(u'\u00E8')));
+    CHECK(IsSmartSlot(NormalizeSlot(u'\u201C')));
+    CHECK(IsSmartSlot(NormalizeSlot(u'\uFEFF')));
+    CHECK(NormalizeSlot(u'\u4E2D') == 0);
+    CHECK(NormalizeSlot(static_cast<char16_t>(0xD83D)) == 0);
+
+    // Units past the BMP never index the table
+    CHECK(NormalizeSlot(static_cast<char32_t>(0x1F600)) == 0);
+    CHECK(NormalizeSlot(static_cast<char32_t>(0x12013)) == 0);
+
+    CHECK(SameText(Transliteration(u'\u00E9'), "e"));
+    CHECK(SameText(Transliteration(u'\u00DF'), "ss"));
+    CHECK(SameText(Transliteration(u'\u00A9'), "(c)"));
+    CHECK(SameText(Transliteration(u'\u2192'), "->"));
+    CHECK(Transliteration(u'\u201C') == nullptr);  // Smart mappings are not transliterations
+    CHECK(Transliteration(u'\u00A0') == nullptr);
+    CHECK(Transliteration(u'a') == nullptr);
+}
+
+std::u16string Normalize(std::u16string_view input) {
+    std::u16string scratch;
+    return std::u16string(textnormalize::NormalizeSmartCharacters(input, scratch));
+}
+
+void TestNormalizeSmartCharacters() {
+    // Nothing to replace: the input itself comes back, not a copy
+    std::u16string plain = u"Get-ChildItem -Path C:\\Logs | Sort-Object caf\u00E9 \U0001F600";
+    std::u16string scratch;
+    std::u16string_view result = textnormalize::NormalizeSmartCharacters(std::u16string_view(plain), scratch);
+    CHECK(result.data() == plain.data() && result.size() == plain.size());
+
+    CHECK(Normalize(u"\u201CDon\u2019t\u201D \u2013 wait\u2026") == u"\"Don't\" - wait...");
+    CHECK(Normalize(u"zero\u200Bwidth\u00ADsoft\uFEFF") == u"zerowidthsoft");
+    CHECK(Normalize(u"a\u00A0b\u3000c") == u"a b c");
+    CHECK(Normalize(u"\u2014") == u"-");
+    // Transliterations are left to the planner
+    CHECK(Normalize(u"\u00E9\u2014\u00E9") == u"\u00E9-\u00E9");
+
+    // A smart character at every offset of a run longer than a vector
+    bool ok = true;
+    for (size_t at = 0; at < 41; at++) {
+        std::u16string text(41, u'x');
+        text[at] = u'\u2019';
+        std::u16string expected(41, u'x');
+        expected[at] = u'\'';
+        if (Normalize(text) != expected) {
+            std::printf("  NormalizeSmartCharacters: quote at %zu\n", at);
+            ok = false;
+        }
+    }
+    CHECK(ok);
+}
+
+// ============================================================================
+// pasteplan.h - FindChunkCut
+// ============================================================================
+
+size_t Cut(const std::u16string& pending, bool ended = false) {
+    return inject::FindChunkCut(pending.data(), pending.size(), ended);
+}
+
+void TestFindChunkCut() {
+    using inject::STREAM_CHUNK_UNITS;
+    using inject::STREAM_MAX_CHUNK_UNITS;
+
+    CHECK(Cut(u"") == 0);
+    CHECK(Cut(u"short line\r\n") == 0);                // Less than a chunk: read more
+    CHECK(Cut(u"short line\r\nend", true) == 15);      // Source ended: everything
+
+    // Cut after the last line break
+    std::u16string text(STREAM_CHUNK_UNITS, u'a');
+    text[100] = u'\n';
+    CHECK(Cut(text) == 101);
+    text[3000] = u'\r';
+    text[3001] = u'\n';
+    CHECK(Cut(text) == 3002);
+
+    // A CR as the last unit may be the first half of a CR+LF - cut before it
+    text.back() = u'\r';
+    CHECK(Cut(text) == 3002);
+
+    // A lone CR is a line break once the next unit is here
+    std::u16string crOnly(STREAM_CHUNK_UNITS, u'a');
+    crOnly[50] = u'\r';
+    CHECK(Cut(crOnly) == 51);
+    crOnly.back() = u'\r';
+    CHECK(Cut(crOnly) == 51);
+
+    // No line break: wait for a whole chunk, then cut mid-line
+    std::u16string line(STREAM_MAX_CHUNK_UNITS - 1, u'a');
+    CHECK(Cut(line) == 0);
+    line += u"bb";
+    CHECK(Cut(line) == STREAM_MAX_CHUNK_UNITS);
+
+    // Never between a high and a low surrogate
+    std::u16string pair(STREAM_MAX_CHUNK_UNITS + 10, u'a');
+    pair[STREAM_MAX_CHUNK_UNITS - 1] = u'\xD83D';
+    pair[STREAM_MAX_CHUNK_UNITS] = u'\xDE00';
+    CHECK(Cut(pair) == STREAM_MAX_CHUNK_UNITS - 1);
+
+    // Never between CR and LF (the CR is the last unit pending)
+    std::u16string crlf(STREAM_MAX_CHUNK_UNITS, u'a');
+    crlf.back() = u'\r';
+    CHECK(Cut(crlf) == STREAM_MAX_CHUNK_UNITS - 1);
+}
+
+// ============================================================================
+// pasteplan.h - SeekOps
+// ============================================================================
+
+const uint16_t SCAN_ENTER = 0x1C;
+const uint16_t SCAN_SHIFT = 0x2A;
+
+void AppendOp(std::vector<KeyOp>& ops, uint16_t code, uint8_t flags) {
+    ops.push_back({code, flags, inject::PaceClass::None});
+}
+
+// Ops for text as the planner compiles it in Unicode mode: every character a
+// press and release with its end on the release; CR, LF and CR+LF one Enter;
+// a surrogate pair both halves with a single character end
+std::vector<KeyOp> UnicodeOps(std::u16string_view text) {
+    using namespace inject;
+    std::vector<KeyOp> ops;
+    for (size_t i = 0; i < text.size(); ++i) {
+        char16_t c = text[i];
+        bool crlf = (c == u'\r' && i + 1 < text.size() && text[i + 1] == u'\n');
+        if (c == u'\r' || c == u'\n') {
+            if (crlf) ++i;
+            AppendOp(ops, SCAN_ENTER, 0);
+            AppendOp(ops, SCAN_ENTER, KOP_KEYUP | KOP_CHAR_END | KOP_LINE_END | (crlf ? KOP_PAIR : 0));
+            continue;
+        }
+        bool pair = (c >= 0xD800 && c <= 0xDBFF && i + 1 < text.size() &&
+                     text[i + 1] >= 0xDC00 && text[i + 1] <= 0xDFFF);
+        AppendOp(ops, c, KOP_UNICODE);
+        AppendOp(ops, c, KOP_UNICODE | KOP_KEYUP);
+        if (pair) {
+            char16_t low = text[++i];
+            AppendOp(ops, low, KOP_UNICODE);
+            AppendOp(ops, low, KOP_UNICODE | KOP_KEYUP);
+        }
+        ops.back().flags |= KOP_CHAR_END | (pair ? KOP_PAIR : 0);
+    }
+    return ops;
+}
+
+InjectionCursor Seek(const std::vector<KeyOp>& ops, size_t units, size_t startColumn = 0) {
+    return inject::SeekOps(ops.data(), ops.size(), startColumn, units);
+}
+
+void TestSeekCrLf() {
+    std::vector<KeyOp> ops = UnicodeOps(u"ab\r\ncd");
+    CHECK(ops.size() == 10);
+
+    InjectionCursor c = Seek(ops, 0);
+    CHECK(c.op == 0 && c.units == 0 && c.column == 0 && c.lineStart == 0);
+
+    c = Seek(ops, 2);
+    CHECK(c.op == 4 && c.units == 2 && c.column == 2 && c.lineStart == 0);
+
+    // Between CR and LF: the pair is one Enter, so the cursor lands after it
+    c = Seek(ops, 3);
+    CHECK(c.op == 6 && c.units == 4 && c.column == 0 && c.lineStart == 4);
+
+    c = Seek(ops, 4);
+    CHECK(c.op == 6 && c.units == 4 && c.column == 0 && c.lineStart == 4);
+
+    c = Seek(ops, 5);
+    CHECK(c.op == 8 && c.units == 5 && c.column == 1 && c.lineStart == 4);
+
+    c = Seek(ops, 100);
+    CHECK(c.op == ops.size() && c.units == 6 && c.column == 2);
+
+    // Lone CR and LF each end a line and consume one unit
+    ops = UnicodeOps(u"a\rb\nc");
+    c = Seek(ops, 2);
+    CHECK(c.units == 2 && c.column == 0 && c.lineStart == 2);
+    c = Seek(ops, 4);
+    CHECK(c.units == 4 && c.column == 0 && c.lineStart == 4);
+
+    // A chunk cut mid-line continues the previous chunk's column
+    ops = UnicodeOps(u"xyz\nw");
+    c = Seek(ops, 2, 7);
+    CHECK(c.units == 2 && c.column == 9);
+    c = Seek(ops, 5, 7);
+    CHECK(c.units == 5 && c.column == 1 && c.lineStart == 4);
+}
+
+void TestSeekSurrogates() {
+    std::vector<KeyOp> ops = UnicodeOps(u"a\U0001F600b");
+    CHECK(ops.size() == 8);
+    CHECK(ops[5].flags & inject::KOP_PAIR);
+
+    InjectionCursor c = Seek(ops, 1);
+    CHECK(c.op == 2 && c.units == 1 && c.column == 1);
+
+    // Inside the pair: both halves are one character, never split on resume
+    c = Seek(ops, 2);
+    CHECK(c.op == 6 && c.units == 3 && c.column == 2);
+
+    c = Seek(ops, 3);
+    CHECK(c.op == 6 && c.units == 3 && c.column == 2);
+
+    c = Seek(ops, 4);
+    CHECK(c.op == 8 && c.units == 4 && c.column == 3);
+
+    // Every offset lands on a character boundary of the source
+    std::u16string text = u"\U0001F600\r\n\U0001F601x\r\r\n\U0001F602";
+    ops = UnicodeOps(text);
+    bool ok = true;
+    for (size_t units = 0; units <= text.size(); units++) {
+        c = Seek(ops, units);
+        bool midPair = c.units > 0 && c.units < text.size() &&
+                       text[c.units - 1] >= 0xD800 && text[c.units - 1] <= 0xDBFF;
+        bool midCrLf = c.units > 0 && c.units < text.size() &&
+                       text[c.units - 1] == u'\r' && text[c.units] == u'\n';
+        if (c.units < units || midPair || midCrLf) {
+            std::printf("  SeekOps: offset %zu landed on %zu\n", units, c.units);
+            ok = false;
+        }
+    }
+    CHECK(ok);
+}
+
+void TestSeekShift() {
+    using namespace inject;
+    // "AB" with Shift held across both, then "c"
+    std::vector<KeyOp> ops;
+    AppendOp(ops, SCAN_SHIFT, KOP_SHIFT);
+    AppendOp(ops, 0x1E, 0);
+    AppendOp(ops, 0x1E, KOP_KEYUP | KOP_CHAR_END);
+    AppendOp(ops, 0x30, 0);
+    AppendOp(ops, 0x30, KOP_KEYUP | KOP_CHAR_END);
+    AppendOp(ops, SCAN_SHIFT, KOP_SHIFT | KOP_KEYUP);
+    AppendOp(ops, 0x2E, 0);
+    AppendOp(ops, 0x2E, KOP_KEYUP | KOP_CHAR_END);
+
+    CHECK(Seek(ops, 0).heldShift == 0);
+    CHECK(Seek(ops, 1).heldShift == SCAN_SHIFT);
+    CHECK(Seek(ops, 2).heldShift == SCAN_SHIFT);  // Release comes with the next character
+    InjectionCursor c = Seek(ops, 3);
+    CHECK(c.heldShift == 0 && c.op == ops.size());
+}
+
+int main() {
+    std::printf("SIMD: %s\n", textdecode::SimdLevelName(textdecode::BestSimdLevel()));
+
+    TestDetectEncoding();
+    TestCompleteUtf8Length();
+    TestDecodeUtf8();
+    TestDecodeUtf16();
+    TestAsciiPrefixLength();
+    TestNormalizeTable();
+    TestNormalizeSmartCharacters();
+    TestFindChunkCut();
+    TestSeekCrLf();
+    TestSeekSurrogates();
+    TestSeekShift();
+
+    std::printf("%d checks, %d failed\n", g_checks, g_failures);
+    return g_failures ? 1 : 0;
+}
@@ -0,0 +1,444 @@
+/*
+ * MadPaster - Portable text decoding
+ *
+ * Encoding detection (BOM, BOM-less UTF-16), UTF-8 validation and
+ * UTF-8/UTF-16 to UTF-16 decoding in a single pass. ASCII stretches and
+ * UTF-16 byte swaps use SSE2/AVX2 where available, with a scalar fallback.
+ * No Win32 dependency, so it builds and runs on Linux as well; legacy code
+ * pages (ANSI) are left to the caller. Also scans decoded UTF-16 text for
+ * ASCII stretches (text normalization skips them).
+ */
+
+#ifndef MADPASTER_TEXTDECODE_H
+#define MADPASTER_TEXTDECODE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define TEXTDECODE_X86 1
+#endif
+
+#if defined(TEXTDECODE_X86) && \
+    (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define TEXTDECODE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// AVX2 code is compiled per function and only run when the CPU has it
+#if defined(TEXTDECODE_SSE2) && (defined(__GNUC__) || defined(_MSC_VER))
+#define TEXTDECODE_AVX2 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(TEXTDECODE_AVX2) && defined(__GNUC__)
+#define TEXTDECODE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TEXTDECODE_TARGET_AVX2
+#endif
+
+namespace textdecode {
+
+// ============================================================================
+// Encoding Detection
+// ============================================================================
+
+enum class Encoding {
+    Unknown,   // No BOM and not UTF-16: UTF-8 or a legacy code page
+    Utf8,      // UTF-8 BOM
+    Utf16LE,
+    Utf16BE
+};
+
+struct Detection {
+    Encoding encoding;
+    size_t bomBytes;
+};
+
+// Bytes sampled for BOM-less UTF-16
+const size_t DETECT_SAMPLE_BYTES = 4096;
+
+// BOM first. Without one, UTF-16 shows up as zero bytes in every other
+// position of mostly-ASCII text, which UTF-8 and ANSI text never contain.
+inline Detection DetectEncoding(const unsigned char* data, size_t size) {
+    if (size >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF) {
+        return {Encoding::Utf8, 3};
+    }
+    if (size >= 2 && data[0] == 0xFF && data[1] == 0xFE) {
+        return {Encoding::Utf16LE, 2};
+    }
+    if (size >= 2 && data[0] == 0xFE && data[1] == 0xFF) {
+        return {Encoding::Utf16BE, 2};
+    }
+
+    size_t pairs = ((size < DETECT_SAMPLE_BYTES) ? size : DETECT_SAMPLE_BYTES) / 2;
+    if (pairs >= 2) {
+        size_t zeroEven = 0;
+        size_t zeroOdd = 0;
+        for (size_t i = 0; i < pairs; i++) {
+            if (data[i * 2] == 0) zeroEven++;
+            if (data[i * 2 + 1] == 0) zeroOdd++;
+        }
+        // At least 30% of units zero in the high byte, almost none in the low byte
+        if (zeroOdd * 10 >= pairs * 3 && zeroEven * 20 <= pairs) return {Encoding::Utf16LE, 0};
+        if (zeroEven * 10 >= pairs * 3 && zeroOdd * 20 <= pairs) return {Encoding::Utf16BE, 0};
+    }
+    return {Encoding::Unknown, 0};
+}
+
+// Length of data without a trailing incomplete UTF-8 sequence
+inline size_t CompleteUtf8Length(const unsigned char* data, size_t size) {
+    for (size_t back = 1; back <= 3 && back <= size; back++) {
+        unsigned char b = data[size - back];
+        if ((b & 0xC0) == 0x80) continue;  // Continuation byte - keep looking for the lead
+        size_t needed = (b >= 0xF0) ? 4 : (b >= 0xE0) ? 3 : (b >= 0xC0) ? 2 : 1;
+        return (needed > back) ? size - back : size;
+    }
+    return size;
+}
+
+// ============================================================================
+// SIMD Support
+// ============================================================================
+
+enum class SimdLevel {
+    Scalar,
+    Sse2,
+    Avx2
+};
+
+inline bool CpuHasAvx2() {
+#if defined(TEXTDECODE_AVX2) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;  // OS saves YMM state
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(TEXTDECODE_AVX2)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#else
+    return false;
+#endif
+}
+
+inline SimdLevel DetectSimdLevel() {
+#if defined(TEXTDECODE_SSE2)
+    return CpuHasAvx2() ? SimdLevel::Avx2 : SimdLevel::Sse2;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+// Best level this CPU supports (checked once)
+inline SimdLevel BestSimdLevel() {
+    static const SimdLevel level = DetectSimdLevel();
+    return level;
+}
+
+inline bool IsSimdLevelSupported(SimdLevel level) {
+    return static_cast<int>(level) <= static_cast<int>(BestSimdLevel());
+}
+
+inline const char* SimdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Avx2: return "AVX2";
+        case SimdLevel::Sse2: return "SSE2";
+        default:              return "scalar";
+    }
+}
+
+// Vector kernels write 16-bit units through void* (vector stores may alias anything)
+
+#if defined(TEXTDECODE_SSE2)
+// Widen the leading run of ASCII bytes to 16-bit units, 16 bytes at a time
+// Returns the bytes handled; stops before the first vector holding a non-ASCII byte
+inline size_t WidenAsciiSse2(const unsigned char* data, size_t size, void* out) {
+    unsigned char* dst = static_cast<unsigned char*>(out);
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    while (i + 16 <= size) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        if (_mm_movemask_epi8(v) != 0) break;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2), _mm_unpacklo_epi8(v, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2 + 16), _mm_unpackhi_epi8(v, zero));
+        i += 16;
+    }
+    return i;
+}
+
+// Byte-swap UTF-16 units, 8 at a time; returns the units handled
+inline size_t SwapUnitsSse2(const unsigned char* data, size_t units, void* out) {
+    unsigned char* dst = static_cast<unsigned char*>(out);
+    size_t i = 0;
+    while (i + 8 <= units) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 2));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2), v);
+        i += 8;
+    }
+    return i;
+}
+#endif
+
+#if defined(TEXTDECODE_AVX2)
+TEXTDECODE_TARGET_AVX2
+inline size_t WidenAsciiAvx2(const unsigned char* data, size_t size, void* out) {
+    unsigned char* dst = static_cast<unsigned char*>(out);
+    size_t i = 0;
+    while (i + 32 <= size) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        if (_mm256_movemask_epi8(v) != 0) break;
+        __m256i lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v));
+        __m256i hi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 2), lo);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 2 + 32), hi);
+        i += 32;
+    }
+    return i;
+}
+
+TEXTDECODE_TARGET_AVX2
+inline size_t SwapUnitsAvx2(const unsigned char* data, size_t units, void* out) {
+    unsigned char* dst = static_cast<unsigned char*>(out);
+    size_t i = 0;
+    while (i + 16 <= units) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i * 2));
+        v = _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 2), v);
+        i += 16;
+    }
+    return i;
+}
+#endif
+
+// Leading ASCII run at the given level (0 for scalar)
+inline size_t WidenAscii(const unsigned char* data, size_t size, void* out, SimdLevel level) {
+    size_t i = 0;
+#if defined(TEXTDECODE_AVX2)
+    if (level == SimdLevel::Avx2) i = WidenAsciiAvx2(data, size, out);
+#endif
+#if defined(TEXTDECODE_SSE2)
+    if (level != SimdLevel::Scalar) {
+        i += WidenAsciiSse2(data + i, size - i, static_cast<unsigned char*>(out) + i * 2);
+    }
+#endif
+    (void)data; (void)size; (void)out; (void)level;
+    return i;
+}
+
+inline size_t SwapUnits(const unsigned char* data, size_t units, void* out, SimdLevel level) {
+    size_t i = 0;
+#if defined(TEXTDECODE_AVX2)
+    if (level == SimdLevel::Avx2) i = SwapUnitsAvx2(data, units, out);
+#endif
+#if defined(TEXTDECODE_SSE2)
+    if (level != SimdLevel::Scalar) {
+        i += SwapUnitsSse2(data + i * 2, units - i, static_cast<unsigned char*>(out) + i * 2);
+    }
+#endif
+    (void)data; (void)units; (void)out; (void)level;
+    return i;
+}
+
+// ============================================================================
+// Decoding
+//
+// Unit is the output code unit type (wchar_t on Windows, char16_t elsewhere).
+// Vector paths need 16-bit units; wider units are decoded by the scalar path.
+// ============================================================================
+
+const uint32_t REPLACEMENT_CHARACTER = 0xFFFD;
+
+// Decode one non-ASCII UTF-8 sequence at data[i] (Unicode Table 3-7: no
+// overlongs, surrogates or code points past U+10FFFF). An invalid or truncated
+// sequence becomes one U+FFFD per maximal subpart (Unicode 3.9, U+FFFD
+// substitution): the longest prefix that could still have started a valid
+// sequence is consumed as a whole, so F0 9F 98 gives one U+FFFD, not three.
+template <typename Unit>
+inline void DecodeUtf8Sequence(const unsigned char* data, size_t size, size_t& i,
+                               Unit* out, size_t& o, bool& valid) {
+    unsigned char b0 = data[i];
+    size_t length = 0;
+    unsigned char low = 0x80;   // Allowed range of the second byte
+    unsigned char high = 0xBF;
+
+    if (b0 >= 0xC2 && b0 <= 0xDF) {
+        length = 2;
+    } else if (b0 >= 0xE0 && b0 <= 0xEF) {
+        length = 3;
+        if (b0 == 0xE0) low = 0xA0;   // Overlong
+        if (b0 == 0xED) high = 0x9F;  // Surrogates
+    } else if (b0 >= 0xF0 && b0 <= 0xF4) {
+        length = 4;
+        if (b0 == 0xF0) low = 0x90;   // Overlong
+        if (b0 == 0xF4) high = 0x8F;  // Past U+10FFFF
+    }
+
+    // Bytes that still fit a valid sequence; the second byte has the tighter range
+    size_t matched = (length > 0) ? 1 : 0;
+    if (matched && i + 1 < size && data[i + 1] >= low && data[i + 1] <= high) {
+        matched = 2;
+        while (matched < length && i + matched < size && (data[i + matched] & 0xC0) == 0x80) {
+            matched++;
+        }
+    }
+    if (matched < length || length == 0) {
+        out[o++] = static_cast<Unit>(REPLACEMENT_CHARACTER);
+        valid = false;
+        i += (matched > 0) ? matched : 1;
+        return;
+    }
+
+    uint32_t cp;
+    if (length == 2) {
+        cp = ((b0 & 0x1Fu) << 6) | (data[i + 1] & 0x3Fu);
+    } else if (length == 3) {
+        cp = ((b0 & 0x0Fu) << 12) | ((data[i + 1] & 0x3Fu) << 6) | (data[i + 2] & 0x3Fu);
+    } else {
+        cp = ((b0 & 0x07u) << 18) | ((data[i + 1] & 0x3Fu) << 12) |
+             ((data[i + 2] & 0x3Fu) << 6) | (data[i + 3] & 0x3Fu);
+    }
+    i += length;
+
+    if (cp >= 0x10000 && sizeof(Unit) == 2) {
+        cp -= 0x10000;
+        out[o++] = static_cast<Unit>(0xD800 + (cp >> 10));
+        out[o++] = static_cast<Unit>(0xDC00 + (cp & 0x3FF));
+    } else {
+        out[o++] = static_cast<Unit>(cp);
+    }
+}
+
+// Validate and decode UTF-8 in one pass. out needs room for size units (UTF-8
+// never decodes to more units than bytes). valid is cleared if any byte had to
+// be replaced with U+FFFD. Returns the units written.
+template <typename Unit>
+size_t DecodeUtf8(const unsigned char* data, size_t size, Unit* out, bool& valid,
+                  SimdLevel level = BestSimdLevel()) {
+    bool vectors = (sizeof(Unit) == 2 && level != SimdLevel::Scalar);
+    size_t i = 0;
+    size_t o = 0;
+    valid = true;
+
+    while (i < size) {
+        if (vectors) {
+            size_t run = WidenAscii(data + i, size - i, out + o, level);
+            i += run;
+            o += run;
+        }
+
+        // Scalar for a vector's worth of bytes, then try the ASCII fast path again
+        size_t stop = (size - i < 16) ? size : i + 16;
+        while (i < stop) {
+            if (data[i] < 0x80) {
+                out[o++] = static_cast<Unit>(data[i++]);
+            } else {
+                DecodeUtf8Sequence(data, size, i, out, o, valid);
+            }
+        }
+    }
+    return o;
+}
+
+inline bool HostIsLittleEndian() {
+    const uint16_t probe = 1;
+    unsigned char first;
+    std::memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+// Decode UTF-16 bytes (a trailing odd byte is ignored). out needs room for
+// size / 2 units. Returns the units written.
+template <typename Unit>
+size_t DecodeUtf16(const unsigned char* data, size_t size, bool bigEndian, Unit* out,
+                   SimdLevel level = BestSimdLevel()) {
+    size_t units = size / 2;
+    size_t i = 0;
+
+    if (sizeof(Unit) == 2) {
+        if (bigEndian != !HostIsLittleEndian()) {
+            if (level != SimdLevel::Scalar) i = SwapUnits(data, units, out, level);
+        } else {
+            // Already in host order - a straight copy
+            std::memcpy(out, data, units * 2);
+            return units;
+        }
+    }
+
+    for (; i < units; ++i) {
+        unsigned char first = data[i * 2];
+        unsigned char second = data[i * 2 + 1];
+        out[i] = bigEndian ? static_cast<Unit>((first << 8) | second)
+                           : static_cast<Unit>((second << 8) | first);
+    }
+    return units;
+}
+
+// ============================================================================
+// Scanning
+// ============================================================================
+
+#if defined(TEXTDECODE_SSE2)
+// Count leading 16-bit units below 0x80, 8 at a time; stops before the first
+// vector holding another unit
+inline size_t AsciiUnitsSse2(const void* text, size_t units) {
+    const unsigned char* src = static_cast<const unsigned char*>(text);
+    const __m128i high = _mm_set1_epi16(static_cast<short>(0xFF80));
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    while (i + 8 <= units) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+        __m128i ascii = _mm_cmpeq_epi16(_mm_and_si128(v, high), zero);
+        if (_mm_movemask_epi8(ascii) != 0xFFFF) break;
+        i += 8;
+    }
+    return i;
+}
+#endif
+
+#if defined(TEXTDECODE_AVX2)
+TEXTDECODE_TARGET_AVX2
+inline size_t AsciiUnitsAvx2(const void* text, size_t units) {
+    const unsigned char* src = static_cast<const unsigned char*>(text);
+    const __m256i high = _mm256_set1_epi16(static_cast<short>(0xFF80));
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+    while (i + 16 <= units) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 2));
+        __m256i ascii = _mm256_cmpeq_epi16(_mm256_and_si256(v, high), zero);
+        if (_mm256_movemask_epi8(ascii) != -1) break;
+        i += 16;
+    }
+    return i;
+}
+#endif
+
+// Length of the leading run of ASCII units (below 0x80)
+template <typename Unit>
+size_t AsciiPrefixLength(const Unit* text, size_t length, SimdLevel level = BestSimdLevel()) {
+    size_t i = 0;
+    if (sizeof(Unit) == 2) {
+#if defined(TEXTDECODE_AVX2)
+        if (level == SimdLevel::Avx2) i = AsciiUnitsAvx2(text, length);
+#endif
+#if defined(TEXTDECODE_SSE2)
+        if (level != SimdLevel::Scalar) i += AsciiUnitsSse2(text + i, length - i);
+#endif
+    }
+    (void)level;
+    while (i < length && static_cast<uint32_t>(text[i]) < 0x80) ++i;
+    return i;
+}
+
+} // namespace textdecode
+
+#endif // MADPASTER_TEXTDECODE_H
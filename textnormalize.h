@@ -0,0 +1,273 @@
+/*
+ * MadPaster - Portable text normalization
+ *
+ * Compile-time lookup table of smart-character mappings (typographic
+ * characters with an ASCII equivalent, always applied while a paste is read)
+ * and transliterations (spellings for characters a keyboard layout lacks,
+ * applied by the planner), and the normalizer that applies the smart
+ * mappings block by block. No Win32 dependency, so it builds and runs on
+ * Linux as well; Unit is wchar_t on Windows, char16_t elsewhere.
+ */
+
+#ifndef MADPASTER_TEXTNORMALIZE_H
+#define MADPASTER_TEXTNORMALIZE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "textdecode.h"
+
+namespace textnormalize {
+
+// ============================================================================
+// Normalization Table
+//
+// A page index by high byte, then a mapping slot by low byte, so any BMP
+// character is looked up with two array reads.
+// ============================================================================
+
+struct CharMapping {
+    wchar_t ch;                  // Non-ASCII (ASCII is never looked up)
+    const wchar_t* replacement;  // Empty = drop the character
+};
+
+// Typographic and invisible characters that would otherwise go out as Unicode packets
+constexpr CharMapping SMART_MAPPINGS[] = {
+    { L'\u00A0', L" " },    // NO-BREAK SPACE
+    { L'\u00AD', L"" },     // SOFT HYPHEN
+    { L'\u2000', L" " },    // EN QUAD ... HAIR SPACE
+    { L'\u2001', L" " },
+    { L'\u2002', L" " },
+    { L'\u2003', L" " },
+    { L'\u2004', L" " },
+    { L'\u2005', L" " },
+    { L'\u2006', L" " },
+    { L'\u2007', L" " },
+    { L'\u2008', L" " },
+    { L'\u2009', L" " },
+    { L'\u200A', L" " },
+    { L'\u200B', L"" },     // ZERO WIDTH SPACE
+    { L'\u200C', L"" },     // ZERO WIDTH NON-JOINER
+    { L'\u200D', L"" },     // ZERO WIDTH JOINER
+    { L'\u200E', L"" },     // LEFT-TO-RIGHT MARK
+    { L'\u200F', L"" },     // RIGHT-TO-LEFT MARK
+    { L'\u2010', L"-" },    // HYPHEN
+    { L'\u2011', L"-" },    // NON-BREAKING HYPHEN
+    { L'\u2012', L"-" },    // FIGURE DASH
+    { L'\u2013', L"-" },    // EN DASH
+    { L'\u2014', L"-" },    // EM DASH
+    { L'\u2015', L"-" },    // HORIZONTAL BAR
+    { L'\u2018', L"'" },    // LEFT SINGLE QUOTATION MARK
+    { L'\u2019', L"'" },    // RIGHT SINGLE QUOTATION MARK
+    { L'\u201A', L"'" },    // SINGLE LOW-9 QUOTATION MARK
+    { L'\u201B', L"'" },    // SINGLE HIGH-REVERSED-9 QUOTATION MARK
+    { L'\u201C', L"\"" },   // LEFT DOUBLE QUOTATION MARK
+    { L'\u201D', L"\"" },   // RIGHT DOUBLE QUOTATION MARK
+    { L'\u201E', L"\"" },   // DOUBLE LOW-9 QUOTATION MARK
+    { L'\u201F', L"\"" },   // DOUBLE HIGH-REVERSED-9 QUOTATION MARK
+    { L'\u2022', L"*" },    // BULLET
+    { L'\u2023', L"*" },    // TRIANGULAR BULLET
+    { L'\u2024', L"." },    // ONE DOT LEADER
+    { L'\u2026', L"..." },  // HORIZONTAL ELLIPSIS
+    { L'\u202F', L" " },    // NARROW NO-BREAK SPACE
+    { L'\u2032', L"'" },    // PRIME
+    { L'\u2033', L"\"" },   // DOUBLE PRIME
+    { L'\u2039', L"<" },    // SINGLE LEFT-POINTING ANGLE QUOTATION MARK
+    { L'\u203A', L">" },    // SINGLE RIGHT-POINTING ANGLE QUOTATION MARK
+    { L'\u2043', L"-" },    // HYPHEN BULLET
+    { L'\u2044', L"/" },    // FRACTION SLASH
+    { L'\u205F', L" " },    // MEDIUM MATHEMATICAL SPACE
+    { L'\u2060', L"" },     // WORD JOINER
+    { L'\u2212', L"-" },    // MINUS SIGN
+    { L'\u2215', L"/" },    // DIVISION SLASH
+    { L'\u2219', L"*" },    // BULLET OPERATOR
+    { L'\u25E6', L"*" },    // WHITE BULLET
+    { L'\u3000', L" " },    // IDEOGRAPHIC SPACE
+    { L'\uFEFF', L"" },     // ZERO WIDTH NO-BREAK SPACE (stray BOM)
+};
+
+// Nearest typeable spelling of characters some layouts lack (accented Latin,
+// symbols). Kept as typed when the layout has the key.
+constexpr CharMapping TRANSLITERATIONS[] = {
+    // Latin-1 symbols
+    { L'\u00A1', L"!" },   { L'\u00A2', L"c" },   { L'\u00A3', L"GBP" },
+    { L'\u00A5', L"JPY" }, { L'\u00A6', L"|" },   { L'\u00A7', L"S" },
+    { L'\u00A9', L"(c)" }, { L'\u00AB', L"<<" },  { L'\u00AE', L"(R)" },
+    { L'\u00B0', L"deg" }, { L'\u00B1', L"+/-" }, { L'\u00B2', L"2" },
+    { L'\u00B3', L"3" },   { L'\u00B5', L"u" },   { L'\u00B7', L"." },
+    { L'\u00B9', L"1" },   { L'\u00BB', L">>" },  { L'\u00BC', L"1/4" },
+    { L'\u00BD', L"1/2" }, { L'\u00BE', L"3/4" }, { L'\u00BF', L"?" },
+    // Latin-1 letters
+    { L'\u00C0', L"A" },   { L'\u00C1', L"A" },   { L'\u00C2', L"A" },
+    { L'\u00C3', L"A" },   { L'\u00C4', L"A" },   { L'\u00C5', L"A" },
+    { L'\u00C6', L"AE" },  { L'\u00C7', L"C" },   { L'\u00C8', L"E" },
+    { L'\u00C9', L"E" },   { L'\u00CA', L"E" },   { L'\u00CB', L"E" },
+    { L'\u00CC', L"I" },   { L'\u00CD', L"I" },   { L'\u00CE', L"I" },
+    { L'\u00CF', L"I" },   { L'\u00D0', L"D" },   { L'\u00D1', L"N" },
+    { L'\u00D2', L"O" },   { L'\u00D3', L"O" },   { L'\u00D4', L"O" },
+    { L'\u00D5', L"O" },   { L'\u00D6', L"O" },   { L'\u00D7', L"x" },
+    { L'\u00D8', L"O" },   { L'\u00D9', L"U" },   { L'\u00DA', L"U" },
+    { L'\u00DB', L"U" },   { L'\u00DC', L"U" },   { L'\u00DD', L"Y" },
+    { L'\u00DE', L"TH" },  { L'\u00DF', L"ss" },  { L'\u00E0', L"a" },
+    { L'\u00E1', L"a" },   { L'\u00E2', L"a" },   { L'\u00E3', L"a" },
+    { L'\u00E4', L"a" },   { L'\u00E5', L"a" },   { L'\u00E6', L"ae" },
+    { L'\u00E7', L"c" },   { L'\u00E8', L"e" },   { L'\u00E9', L"e" },
+    { L'\u00EA', L"e" },   { L'\u00EB', L"e" },   { L'\u00EC', L"i" },
+    { L'\u00ED', L"i" },   { L'\u00EE', L"i" },   { L'\u00EF', L"i" },
+    { L'\u00F0', L"d" },   { L'\u00F1', L"n" },   { L'\u00F2', L"o" },
+    { L'\u00F3', L"o" },   { L'\u00F4', L"o" },   { L'\u00F5', L"o" },
+    { L'\u00F6', L"o" },   { L'\u00F7', L"/" },   { L'\u00F8', L"o" },
+    { L'\u00F9', L"u" },   { L'\u00FA', L"u" },   { L'\u00FB', L"u" },
+    { L'\u00FC', L"u" },   { L'\u00FD', L"y" },   { L'\u00FE', L"th" },
+    { L'\u00FF', L"y" },
+    // Latin Extended-A (Central European, Turkish)
+    { L'\u0104', L"A" },   { L'\u0105', L"a" },   { L'\u0106', L"C" },
+    { L'\u0107', L"c" },   { L'\u010C', L"C" },   { L'\u010D', L"c" },
+    { L'\u010E', L"D" },   { L'\u010F', L"d" },   { L'\u0110', L"D" },
+    { L'\u0111', L"d" },   { L'\u0118', L"E" },   { L'\u0119', L"e" },
+    { L'\u011A', L"E" },   { L'\u011B', L"e" },   { L'\u011E', L"G" },
+    { L'\u011F', L"g" },   { L'\u0130', L"I" },   { L'\u0131', L"i" },
+    { L'\u0141', L"L" },   { L'\u0142', L"l" },   { L'\u0143', L"N" },
+    { L'\u0144', L"n" },   { L'\u0147', L"N" },   { L'\u0148', L"n" },
+    { L'\u0150', L"O" },   { L'\u0151', L"o" },   { L'\u0152', L"OE" },
+    { L'\u0153', L"oe" },  { L'\u0158', L"R" },   { L'\u0159', L"r" },
+    { L'\u015A', L"S" },   { L'\u015B', L"s" },   { L'\u015E', L"S" },
+    { L'\u015F', L"s" },   { L'\u0160', L"S" },   { L'\u0161', L"s" },
+    { L'\u0162', L"T" },   { L'\u0163', L"t" },   { L'\u0164', L"T" },
+    { L'\u0165', L"t" },   { L'\u016E', L"U" },   { L'\u016F', L"u" },
+    { L'\u0170', L"U" },   { L'\u0171', L"u" },   { L'\u0178', L"Y" },
+    { L'\u0179', L"Z" },   { L'\u017A', L"z" },   { L'\u017B', L"Z" },
+    { L'\u017C', L"z" },   { L'\u017D', L"Z" },   { L'\u017E', L"z" },
+    // Currency, arrows and relations
+    { L'\u20AC', L"EUR" }, { L'\u2122', L"TM" },
+    { L'\u2190', L"<-" },  { L'\u2192', L"->" },  { L'\u2194', L"<->" },
+    { L'\u21D0', L"<=" },  { L'\u21D2', L"=>" },  { L'\u21D4', L"<=>" },
+    { L'\u2248', L"~" },   { L'\u2260', L"!=" },  { L'\u2264', L"<=" },
+    { L'\u2265', L">=" },
+};
+
+constexpr size_t SMART_MAPPING_COUNT = sizeof(SMART_MAPPINGS) / sizeof(SMART_MAPPINGS[0]);
+constexpr size_t TRANSLITERATION_COUNT = sizeof(TRANSLITERATIONS) / sizeof(TRANSLITERATIONS[0]);
+constexpr size_t NORMALIZE_MAX_PAGES = 12; // Pages holding at least one mapping
+
+static_assert(SMART_MAPPING_COUNT + TRANSLITERATION_COUNT <= 255,
+              "Mapping slots must fit in a byte");
+
+// Slot 1..SMART_MAPPING_COUNT is a smart mapping, above that a transliteration
+constexpr const CharMapping& MappingAt(size_t slot) {
+    return (slot <= SMART_MAPPING_COUNT) ? SMART_MAPPINGS[slot - 1]
+                                         : TRANSLITERATIONS[slot - 1 - SMART_MAPPING_COUNT];
+}
+
+struct NormalizeTable {
+    uint8_t pageIndex[256];                      // High byte -> page (page 0 maps nothing)
+    uint8_t slots[NORMALIZE_MAX_PAGES + 1][256]; // Low byte -> mapping slot (0 = unchanged)
+};
+
+constexpr size_t CountNormalizePages() {
+    bool used[256] = {};
+    size_t pages = 0;
+    for (size_t slot = 1; slot <= SMART_MAPPING_COUNT + TRANSLITERATION_COUNT; ++slot) {
+        size_t high = static_cast<uint16_t>(MappingAt(slot).ch) >> 8;
+        if (!used[high]) {
+            used[high] = true;
+            pages++;
+        }
+    }
+    return pages;
+}
+
+constexpr bool MappingsAreNonAscii() {
+    for (size_t slot = 1; slot <= SMART_MAPPING_COUNT + TRANSLITERATION_COUNT; ++slot) {
+        if (static_cast<uint16_t>(MappingAt(slot).ch) < 0x80) return false;
+    }
+    return true;
+}
+
+static_assert(CountNormalizePages() <= NORMALIZE_MAX_PAGES, "Raise NORMALIZE_MAX_PAGES");
+static_assert(MappingsAreNonAscii(), "The normalizer skips ASCII without a lookup");
+
+// A character listed twice keeps its first (smart) mapping
+constexpr NormalizeTable BuildNormalizeTable() {
+    NormalizeTable table = {};
+    uint8_t pages = 0;
+    for (size_t slot = 1; slot <= SMART_MAPPING_COUNT + TRANSLITERATION_COUNT; ++slot) {
+        uint16_t ch = static_cast<uint16_t>(MappingAt(slot).ch);
+        uint8_t& page = table.pageIndex[ch >> 8];
+        if (page == 0) page = ++pages;
+        uint8_t& entry = table.slots[page][ch & 0xFF];
+        if (entry == 0) entry = static_cast<uint8_t>(slot);
+    }
+    return table;
+}
+
+constexpr NormalizeTable NORMALIZE_TABLE = BuildNormalizeTable();
+
+// Mapping slot of a code unit (0 = unchanged); units past the BMP (32-bit
+// wchar_t) are never mapped
+template <typename Unit>
+inline uint8_t NormalizeSlot(Unit ch) {
+    uint32_t unit = static_cast<uint32_t>(ch);
+    if (sizeof(Unit) > 2 && unit > 0xFFFF) return 0;
+    return NORMALIZE_TABLE.slots[NORMALIZE_TABLE.pageIndex[unit >> 8]][unit & 0xFF];
+}
+
+inline bool IsSmartSlot(uint8_t slot) {
+    return slot != 0 && slot <= SMART_MAPPING_COUNT;
+}
+
+// Typeable spelling for a character the layout lacks, or nullptr if there is none
+template <typename Unit>
+inline const wchar_t* Transliteration(Unit ch) {
+    uint8_t slot = NormalizeSlot(ch);
+    return (slot > SMART_MAPPING_COUNT) ? MappingAt(slot).replacement : nullptr;
+}
+
+// ============================================================================
+// Normalization
+// ============================================================================
+
+// Index of the first character at or after from with a smart mapping (length if none)
+// ASCII stretches are skipped by textdecode::AsciiPrefixLength: 16 units per
+// step with AVX2, 8 with SSE2, then unit by unit up to the next non-ASCII unit
+template <typename Unit>
+size_t FindSmartCharacter(const Unit* text, size_t length, size_t from) {
+    size_t i = from;
+    for (;;) {
+        i += textdecode::AsciiPrefixLength(text + i, length - i);
+        if (i >= length || IsSmartSlot(NormalizeSlot(text[i]))) return i;
+        ++i;
+    }
+}
+
+// Normalize typographic Unicode characters to ASCII equivalents (SMART_MAPPINGS)
+// Prevents garbled output in remote desktop sessions (Citrix, RDP, VNC)
+// Returns input itself when nothing needs replacing; otherwise the normalized
+// text, built in scratch (reused between blocks, so it stops allocating)
+template <typename Unit>
+std::basic_string_view<Unit> NormalizeSmartCharacters(std::basic_string_view<Unit> input,
+                                                      std::basic_string<Unit>& scratch) {
+    const Unit* text = input.data();
+    size_t length = input.size();
+
+    size_t next = FindSmartCharacter(text, length, 0);
+    if (next == length) return input;
+
+    scratch.assign(text, next);
+    while (next < length) {
+        // Replacements are ASCII, so they widen to any unit type
+        for (const wchar_t* p = MappingAt(NormalizeSlot(text[next])).replacement; *p; ++p) {
+            scratch += static_cast<Unit>(*p);
+        }
+        size_t start = next + 1;
+        next = FindSmartCharacter(text, length, start);
+        scratch.append(text + start, next - start);
+    }
+    return scratch;
+}
+
+} // namespace textnormalize
+
+#endif // MADPASTER_TEXTNORMALIZE_H